@@ -0,0 +1,162 @@
+#pragma once
+
+#include "sds_benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+//--------------------------------------------------------------
+// The obvious alternatives to SDS: look at every cell, or look at random
+// cells and trust the tally. Both return per hill counts indexed like
+// hill_geometry::get_hill_index(), so they can be checked against the ground
+// truth the same way.
+
+//--------------------------------------------------------------
+// Set bits in [begin, end) of a little endian bit array, up to 56 bits per
+// 64-bit popcount. Only the bytes the range covers are read.
+inline size_t count_set_bits(const unsigned char* data, std::uint64_t begin, std::uint64_t end)
+{
+    size_t count = 0;
+    while (begin < end)
+    {
+        const unsigned int shift = unsigned(begin % 8);
+        const unsigned int bits = unsigned(std::min<std::uint64_t>(end - begin, 56));
+        std::uint64_t word = 0;
+        std::memcpy(&word, data + begin / 8, (shift + bits + 7) / 8);
+        word = (word >> shift) & ((std::uint64_t(1) << bits) - 1);
+        count += size_t(__builtin_popcountll(word));
+        begin += bits;
+    }
+    return count;
+}
+
+//--------------------------------------------------------------
+// Splits the hill rows over threads; each thread only writes the counts of
+// its own hills.
+template <typename row_scan>
+void scan_hill_rows_in_parallel(size_t hills_per_side, row_scan scan)
+{
+    const size_t thread_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), hills_per_side));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; ++t)
+        threads.emplace_back([&, t]()
+        {
+            for (size_t hill_y = t; hill_y < hills_per_side; hill_y += thread_count)
+                scan(hill_y);
+        });
+    for (auto& thread : threads)
+        thread.join();
+}
+
+//--------------------------------------------------------------
+// Every row of a tile is a contiguous run of bits, so each row of each hill
+// is counted a tile-row segment at a time with word popcounts.
+inline std::vector<std::uint32_t> scan_hill_counts(const packed_world_view& world,
+                                                   const hill_geometry& geometry)
+{
+    const size_t hills = geometry.hills_per_side;
+    const size_t quad_size = geometry.quad_size;
+    const size_t tile_size = world.tile_size;
+    std::vector<std::uint32_t> counts(hills * hills, 0);
+    scan_hill_rows_in_parallel(hills, [&](size_t hill_y)
+    {
+        for (size_t y = hill_y * quad_size; y < std::min((hill_y + 1) * quad_size, world.grid_size); ++y)
+        {
+            for (size_t x = 0; x < world.grid_size;)
+            {
+                const size_t hill_end = (x / quad_size + 1) * quad_size;
+                const size_t tile_end = (x / tile_size + 1) * tile_size;
+                const size_t end = std::min(std::min(hill_end, tile_end), world.grid_size);
+                const std::uint64_t first = world.get_bit_address(x, y);
+                counts[x / quad_size + hill_y * hills] += std::uint32_t(count_set_bits(world.get_data(), first, first + (end - x)));
+                x = end;
+            }
+        }
+    });
+    return counts;
+}
+
+//--------------------------------------------------------------
+// Every hill of a grid_world is one contiguous block of bytes, so each is a
+// straight byte sum with no per-cell addressing.
+inline std::vector<std::uint32_t> scan_hill_counts(const grid_world& world,
+                                                   const hill_geometry& geometry)
+{
+    const size_t hills = geometry.hills_per_side;
+    const size_t quad_size = geometry.quad_size;
+    const size_t hill_area = quad_size * quad_size;
+    std::vector<std::uint32_t> counts(hills * hills, 0);
+    scan_hill_rows_in_parallel(hills, [&](size_t hill_y)
+    {
+        for (size_t hill_x = 0; hill_x < hills; ++hill_x)
+        {
+            const unsigned char* cells = world.get_cell_address(hill_x * quad_size, hill_y * quad_size);
+            std::uint32_t count = 0;
+            for (size_t i = 0; i < hill_area; ++i)
+                count += cells[i];
+            counts[hill_x + hill_y * hills] = count;
+        }
+    });
+    return counts;
+}
+
+//--------------------------------------------------------------
+// Tests samples_per_round random cells per round, tallying gold by hill,
+// until the hill with the highest tally has been one of the truly best hills
+// for stable_rounds rounds in a row. With samples_per_round equal to the
+// agent count this spends the same tests per round as an SDS iteration.
+template <typename world_type>
+accuracy_result run_sampling_until_correct(const world_type& world,
+                                           const hill_geometry& geometry,
+                                           const std::vector<std::uint32_t>& hill_counts,
+                                           random_uniform& uniform_random,
+                                           size_t samples_per_round,
+                                           size_t max_rounds,
+                                           size_t stable_rounds)
+{
+    const std::uint32_t best_count = *std::max_element(hill_counts.begin(), hill_counts.end());
+    std::vector<std::uint32_t> tallies(hill_counts.size(), 0);
+    std::vector<size_t> sample_x;
+    std::vector<size_t> sample_y;
+    size_t best_hill = 0;
+    accuracy_result result;
+    size_t streak = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < max_rounds; ++round)
+    {
+        uniform_random.fill_next(sample_x, samples_per_round, geometry.grid_size - 1);
+        uniform_random.fill_next(sample_y, samples_per_round, geometry.grid_size - 1);
+        for (size_t i = 0; i < samples_per_round; ++i)
+        {
+            if (!world.is_gold(sample_x[i], sample_y[i]))
+                continue;
+            const size_t hill = geometry.get_hill_index(sample_x[i], sample_y[i]);
+            if (++tallies[hill] > tallies[best_hill])
+                best_hill = hill;
+        }
+
+        const bool correct = tallies[best_hill] > 0 && hill_counts[best_hill] == best_count;
+        if (correct && streak++ == 0)
+        {
+            result.iterations = round + 1;
+            result.tests = (round + 1) * samples_per_round;
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        else if (!correct)
+            streak = 0;
+
+        if (streak >= stable_rounds)
+        {
+            result.correct = true;
+            return result;
+        }
+    }
+    result.iterations = max_rounds;
+    result.tests = max_rounds * samples_per_round;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <vector>
+
+//--------------------------------------------------------------
+// SDS over real valued hypotheses, for tuning parameters rather than finding
+// hills. A hypothesis is a point in N dimensions and the objective, which is
+// minimised, is a sum of terms. A test evaluates a single term, the partial
+// evaluation that makes SDS cheap, and an agent is happy when its term is no
+// worse than a random rival's. Unhappy agents poll a random agent: if it is
+// happy they move near its position, the continuous counterpart of moving
+// to a random cell in the same hill, otherwise anywhere in the bounds.
+//
+// Positions are stored a dimension at a time, so objectives evaluate a term
+// for a whole batch of agents with plain loops over contiguous floats that
+// the compiler vectorises.
+//
+// An objective provides:
+//     size_t get_term_count() const;
+//     void evaluate_term(size_t term, const float* const* positions, size_t count, float* values) const;
+// where positions[d][i] is coordinate d of agent i.
+
+//--------------------------------------------------------------
+// Fits the weights w of a linear model y = w . a to samples (a, y); each
+// term is the squared residual of one sample.
+class linear_fit_objective
+{
+private:
+    std::vector<float> features;
+    std::vector<float> targets;
+    size_t dimensions;
+
+public:
+    linear_fit_objective() :
+        features{},
+        targets{},
+        dimensions{0}
+    {}
+
+    void reset(size_t dimension_count)
+    {
+        dimensions = dimension_count;
+        features.clear();
+        targets.clear();
+    }
+
+    void add_sample(const std::vector<float>& sample_features, float target)
+    {
+        features.insert(features.end(), sample_features.begin(), sample_features.begin() + dimensions);
+        targets.push_back(target);
+    }
+
+    size_t get_term_count() const
+    {
+        return targets.size();
+    }
+
+    void evaluate_term(size_t term, const float* const* positions, size_t count, float* __restrict values) const
+    {
+        const float* sample = features.data() + term * dimensions;
+        std::fill(values, values + count, -targets[term]);
+        for (size_t d = 0; d < dimensions; ++d)
+        {
+            const float weight = sample[d];
+            const float* __restrict coordinates = positions[d];
+            for (size_t i = 0; i < count; ++i)
+                values[i] += weight * coordinates[i];
+        }
+        for (size_t i = 0; i < count; ++i)
+            values[i] *= values[i];
+    }
+};
+
+//--------------------------------------------------------------
+template <typename objective_type>
+class continuous_sds
+{
+private:
+    const objective_type* objective;
+    std::vector<float> lower;
+    std::vector<float> upper;
+    std::vector<std::vector<float>> positions;
+    std::vector<const float*> position_pointers;
+    std::vector<unsigned char> happy;
+    std::vector<float> values;
+    std::vector<float> totals;
+    std::mt19937 random_number_generator;
+    float spread;
+    size_t agent_count;
+
+    float get_uniform(size_t dimension)
+    {
+        std::uniform_real_distribution<float> uniform(lower[dimension], upper[dimension]);
+        return uniform(random_number_generator);
+    }
+
+    size_t get_agent()
+    {
+        std::uniform_int_distribution<size_t> uniform(0, agent_count - 1);
+        return uniform(random_number_generator);
+    }
+
+    // Any agent but the given one, which would always tie with itself.
+    size_t get_rival(size_t self)
+    {
+        std::uniform_int_distribution<size_t> uniform(0, agent_count - 2);
+        const size_t rival = uniform(random_number_generator);
+        return rival < self ? rival : rival + 1;
+    }
+
+    bool has_terms() const
+    {
+        return objective != nullptr && objective->get_term_count() > 0;
+    }
+
+public:
+    continuous_sds() :
+        objective{nullptr},
+        lower{},
+        upper{},
+        positions{},
+        position_pointers{},
+        happy{},
+        values{},
+        totals{},
+        random_number_generator{std::random_device()()},
+        spread{0.01f},
+        agent_count{0}
+    {}
+
+    // Spread is the standard deviation of a recruit's offset from the agent
+    // that recruited it, as a fraction of each dimension's range.
+    void reset(const objective_type& searched,
+               size_t agents,
+               const std::vector<float>& lower_bounds,
+               const std::vector<float>& upper_bounds,
+               float recruit_spread,
+               unsigned int seed)
+    {
+        objective = &searched;
+        lower = lower_bounds;
+        upper = upper_bounds;
+        spread = recruit_spread;
+        agent_count = std::max<size_t>(agents, 1);
+        random_number_generator.seed(seed);
+
+        positions.assign(lower.size(), std::vector<float>(agent_count));
+        position_pointers.resize(lower.size());
+        for (size_t d = 0; d < positions.size(); ++d)
+        {
+            position_pointers[d] = positions[d].data();
+            for (auto& coordinate : positions[d])
+                coordinate = get_uniform(d);
+        }
+        happy.assign(agent_count, 0);
+        values.resize(agent_count);
+    }
+
+    size_t size() const
+    {
+        return agent_count;
+    }
+
+    size_t get_dimensions() const
+    {
+        return positions.size();
+    }
+
+    // One test phase and one diffusion phase; returns the number of happy
+    // agents. Does nothing before reset(), for an objective without terms or
+    // for a lone agent with no rival.
+    size_t iterate()
+    {
+        if (!has_terms() || agent_count < 2)
+            return 0;
+
+        // Every agent is tested on the same randomly chosen term, in one batch.
+        std::uniform_int_distribution<size_t> terms(0, objective->get_term_count() - 1);
+        objective->evaluate_term(terms(random_number_generator), position_pointers.data(), agent_count, values.data());
+        size_t happy_count = 0;
+        for (size_t i = 0; i < agent_count; ++i)
+        {
+            happy[i] = values[i] <= values[get_rival(i)];
+            happy_count += happy[i];
+        }
+
+        std::normal_distribution<float> offset(0.0f, spread);
+        for (size_t i = 0; i < agent_count; ++i)
+        {
+            if (happy[i])
+                continue;
+            const size_t polled = get_agent();
+            for (size_t d = 0; d < positions.size(); ++d)
+            {
+                const float range = upper[d] - lower[d];
+                positions[d][i] = happy[polled]
+                    ? std::min(std::max(positions[d][polled] + offset(random_number_generator) * range, lower[d]), upper[d])
+                    : get_uniform(d);
+            }
+        }
+        return happy_count;
+    }
+
+    // Evaluates every term for every agent, and copies out the position of
+    // the agent with the lowest full objective. Far more work than an
+    // iteration, so call it to report rather than on every step. Without an
+    // objective to evaluate there is no best, and best is left empty.
+    float get_best(std::vector<float>& best)
+    {
+        if (!has_terms())
+        {
+            best.clear();
+            return std::numeric_limits<float>::max();
+        }
+
+        totals.assign(agent_count, 0.0f);
+        for (size_t term = 0; term < objective->get_term_count(); ++term)
+        {
+            objective->evaluate_term(term, position_pointers.data(), agent_count, values.data());
+            for (size_t i = 0; i < agent_count; ++i)
+                totals[i] += values[i];
+        }
+
+        const size_t best_agent = size_t(std::min_element(totals.begin(), totals.end()) - totals.begin());
+        best.resize(positions.size());
+        for (size_t d = 0; d < positions.size(); ++d)
+            best[d] = positions[d][best_agent];
+        return totals[best_agent];
+    }
+};
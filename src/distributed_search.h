@@ -0,0 +1,283 @@
+#pragma once
+
+#include "sds_engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+//--------------------------------------------------------------
+// Agents split across worker processes that all map the same world file.
+// After each iteration a worker publishes a sample of its happy agents' hill
+// indices and its hill counts into shared memory. At the start of the next
+// iteration, every worker moves some unhappy agents onto hills sampled from
+// the other workers. A coordinator sums the hill counts. Workers and the
+// coordinator step in lock step, and the time spent on that exchange is
+// measured separately from the search itself.
+const size_t distributed_max_samples = 256;
+const size_t distributed_max_hills = 256;
+
+//--------------------------------------------------------------
+struct distributed_slot
+{
+    std::uint32_t sample_count;
+    std::uint32_t hill_count;
+    std::uint64_t samples[distributed_max_samples];
+    std::uint64_t hills[distributed_max_hills][2];
+};
+
+//--------------------------------------------------------------
+struct distributed_worker_state
+{
+    alignas(64) std::atomic<std::uint64_t> published;
+    std::atomic<std::uint64_t> communication_ns;
+    std::atomic<std::uint64_t> recruited;
+    distributed_slot slots[2];
+};
+
+//--------------------------------------------------------------
+// The header at the start of the shared mapping. One distributed_worker_state
+// per worker follows it, at the first suitably aligned offset.
+struct distributed_shared_state
+{
+    alignas(64) std::atomic<std::uint64_t> coordinated;
+    std::atomic<int> failed;
+
+    static size_t get_workers_offset()
+    {
+        const size_t alignment = alignof(distributed_worker_state);
+        return (sizeof(distributed_shared_state) + alignment - 1) / alignment * alignment;
+    }
+
+    distributed_worker_state& get_worker(size_t worker)
+    {
+        unsigned char* workers = reinterpret_cast<unsigned char*>(this) + get_workers_offset();
+        return reinterpret_cast<distributed_worker_state*>(workers)[worker];
+    }
+};
+
+//--------------------------------------------------------------
+struct distributed_report
+{
+    bool ok = false;
+    size_t best_hill = 0;
+    size_t best_count = 0;
+    double seconds = 0.0;
+    double communication_seconds_per_iteration = 0.0;
+    unsigned long long recruited = 0;
+};
+
+//--------------------------------------------------------------
+inline size_t get_distributed_shared_size(size_t workers)
+{
+    return distributed_shared_state::get_workers_offset() + workers * sizeof(distributed_worker_state);
+}
+
+//--------------------------------------------------------------
+// Spins until every worker has published at least the given iteration and
+// the coordinator has consumed at least the given one.
+inline bool wait_for_iteration(distributed_shared_state& shared,
+                               size_t workers,
+                               std::uint64_t published,
+                               std::uint64_t coordinated)
+{
+    for (;;)
+    {
+        if (shared.failed.load(std::memory_order_acquire))
+            return false;
+
+        bool ready = shared.coordinated.load(std::memory_order_acquire) >= coordinated;
+        for (size_t w = 0; w < workers && ready; ++w)
+            ready = shared.get_worker(w).published.load(std::memory_order_acquire) >= published;
+        if (ready)
+            return true;
+        std::this_thread::yield();
+    }
+}
+
+//--------------------------------------------------------------
+inline void run_distributed_worker(distributed_shared_state& shared,
+                                   size_t worker,
+                                   size_t workers,
+                                   const std::string& world_path,
+                                   size_t agents_per_worker,
+                                   size_t iterations)
+{
+    mapped_world world;
+    if (!world.open(world_path))
+    {
+        shared.failed.store(1, std::memory_order_release);
+        return;
+    }
+
+    const packed_world_view view = world.view();
+    const hill_geometry geometry(world.grid_size(), world.partial_size());
+    const sds_phases phases = get_sds_phases(geometry.grid_size, geometry.quad_size);
+    sds_population population;
+    reset_population(population, agents_per_worker, geometry.grid_size);
+
+    distributed_worker_state& own = shared.get_worker(worker);
+    std::vector<std::uint64_t> remote_hills;
+    for (size_t t = 0; t < iterations; ++t)
+    {
+        const auto exchange_start = std::chrono::steady_clock::now();
+        if (!wait_for_iteration(shared, workers, t, t))
+            return;
+
+        // Recruitment from other workers' happy agents last iteration.
+        remote_hills.clear();
+        if (t > 0)
+        {
+            for (size_t w = 0; w < workers; ++w)
+            {
+                if (w == worker)
+                    continue;
+                const distributed_slot& slot = shared.get_worker(w).slots[(t - 1) % 2];
+                remote_hills.insert(remote_hills.end(), slot.samples, slot.samples + slot.sample_count);
+            }
+        }
+        auto exchange_time = std::chrono::steady_clock::now() - exchange_start;
+
+        const size_t quad_size = geometry.quad_size;
+        size_t recruited = 0;
+        const size_t quota = remote_hills.size() / workers;
+        for (auto& agent : population.agents)
+        {
+            if (recruited >= quota)
+                break;
+            if (agent->happy)
+                continue;
+            const size_t hill = remote_hills[population.uniform_random.get_next(remote_hills.size() - 1)];
+            agent->x = std::min((hill % geometry.hills_per_side) * quad_size + population.uniform_random.get_next(quad_size - 1),
+                                geometry.grid_size - 1);
+            agent->y = std::min((hill / geometry.hills_per_side) * quad_size + population.uniform_random.get_next(quad_size - 1),
+                                geometry.grid_size - 1);
+            agent->moved = true;
+            ++recruited;
+        }
+
+        begin_iteration(population);
+        test_population(population, view, t == 0);
+        finish_iteration(population, phases, geometry);
+
+        const auto publish_start = std::chrono::steady_clock::now();
+        distributed_slot& slot = own.slots[t % 2];
+        slot.sample_count = std::uint32_t(std::min(population.happy_agents.size(), distributed_max_samples));
+        for (size_t i = 0; i < slot.sample_count; ++i)
+        {
+            const auto& happy = population.happy_agents[i];
+            slot.samples[i] = geometry.get_hill_index(happy->x, happy->y);
+        }
+
+        const std::vector<hill_count> top_hills = population.hill_indices.get_top(distributed_max_hills);
+        slot.hill_count = std::uint32_t(top_hills.size());
+        for (size_t i = 0; i < top_hills.size(); ++i)
+        {
+            slot.hills[i][0] = top_hills[i].index;
+            slot.hills[i][1] = top_hills[i].count;
+        }
+        own.published.store(t + 1, std::memory_order_release);
+        exchange_time += std::chrono::steady_clock::now() - publish_start;
+
+        own.communication_ns.fetch_add(std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(exchange_time).count()),
+                                       std::memory_order_relaxed);
+        own.recruited.fetch_add(recruited, std::memory_order_relaxed);
+    }
+}
+
+//--------------------------------------------------------------
+// Forks the workers, coordinates them for the given number of iterations and
+// reports the best hill found. The world must already be in a world file.
+inline distributed_report run_distributed_search(const std::string& world_path,
+                                                 size_t workers,
+                                                 size_t agents_per_worker,
+                                                 size_t iterations)
+{
+    distributed_report report;
+    workers = std::max<size_t>(workers, 1);
+    const size_t shared_size = get_distributed_shared_size(workers);
+    void* memory = mmap(nullptr, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return report;
+
+    auto& shared = *new (memory) distributed_shared_state();
+    for (size_t w = 0; w < workers; ++w)
+        new (&shared.get_worker(w)) distributed_worker_state();
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<pid_t> children;
+    for (size_t w = 0; w < workers; ++w)
+    {
+        const pid_t child = fork();
+        if (child == 0)
+        {
+            run_distributed_worker(shared, w, workers, world_path, agents_per_worker, iterations);
+            _exit(0);
+        }
+        if (child < 0)
+        {
+            shared.failed.store(1, std::memory_order_release);
+            break;
+        }
+        children.push_back(child);
+    }
+
+    std::map<size_t, size_t> hill_counts;
+    for (size_t t = 0; t < iterations && children.size() == workers; ++t)
+    {
+        if (!wait_for_iteration(shared, workers, t + 1, t))
+            break;
+
+        hill_counts.clear();
+        for (size_t w = 0; w < workers; ++w)
+        {
+            const distributed_slot& slot = shared.get_worker(w).slots[t % 2];
+            for (size_t i = 0; i < slot.hill_count; ++i)
+                hill_counts[slot.hills[i][0]] += slot.hills[i][1];
+        }
+        shared.coordinated.store(t + 1, std::memory_order_release);
+        report.ok = t + 1 == iterations;
+    }
+
+    if (!report.ok)
+    {
+        shared.failed.store(1, std::memory_order_release);
+        for (const pid_t child : children)
+            kill(child, SIGTERM);
+    }
+    for (const pid_t child : children)
+        waitpid(child, nullptr, 0);
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (const auto& hill : hill_counts)
+    {
+        if (hill.second > report.best_count)
+        {
+            report.best_count = hill.second;
+            report.best_hill = hill.first;
+        }
+    }
+
+    std::uint64_t communication_ns = 0;
+    for (size_t w = 0; w < workers; ++w)
+    {
+        communication_ns += shared.get_worker(w).communication_ns.load();
+        report.recruited += shared.get_worker(w).recruited.load();
+    }
+    if (iterations > 0)
+        report.communication_seconds_per_iteration = double(communication_ns) * 1e-9 / double(workers * iterations);
+
+    munmap(memory, shared_size);
+    return report;
+}
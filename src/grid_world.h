@@ -0,0 +1,169 @@
+#pragma once
+
+#include "hill_geometry.h"
+#include "huge_page_allocator.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+//--------------------------------------------------------------
+inline std::uint64_t spread_bits(std::uint64_t v)
+{
+    v &= 0xffffffff;
+    v = (v | (v << 16)) & 0x0000ffff0000ffff;
+    v = (v | (v << 8)) & 0x00ff00ff00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0f;
+    v = (v | (v << 2)) & 0x3333333333333333;
+    v = (v | (v << 1)) & 0x5555555555555555;
+    return v;
+}
+
+//--------------------------------------------------------------
+inline std::uint64_t compact_bits(std::uint64_t v)
+{
+    v &= 0x5555555555555555;
+    v = (v | (v >> 1)) & 0x3333333333333333;
+    v = (v | (v >> 2)) & 0x0f0f0f0f0f0f0f0f;
+    v = (v | (v >> 4)) & 0x00ff00ff00ff00ff;
+    v = (v | (v >> 8)) & 0x0000ffff0000ffff;
+    v = (v | (v >> 16)) & 0x00000000ffffffff;
+    return v;
+}
+
+//--------------------------------------------------------------
+inline std::uint64_t get_morton_code(size_t x, size_t y)
+{
+    return spread_bits(x) | (spread_bits(y) << 1);
+}
+
+//--------------------------------------------------------------
+enum class grid_layout
+{
+    morton,
+    tiled
+};
+
+//--------------------------------------------------------------
+// The in-memory world, one byte per cell, laid out so that every hill is one
+// contiguous block. Power of two worlds and hills use Morton order, where
+// aligned hills are contiguous for free; anything else is stored hill by
+// hill with each hill in row order, and hills cut short by the edge of the
+// world keep their full size with the missing cells never gold.
+class grid_world
+{
+private:
+    std::vector<unsigned char, huge_page_allocator<unsigned char>> cells;
+    size_t cell_count;
+    hill_geometry hills;
+    size_t hill_area;
+    grid_layout layout;
+
+public:
+    grid_world() :
+        cells{},
+        cell_count{0},
+        hills{},
+        hill_area{0},
+        layout{grid_layout::tiled}
+    {}
+
+    void resize(size_t grid_size, size_t hill_size)
+    {
+        hills = hill_geometry(grid_size, hill_size);
+        hill_area = hill_size * hill_size;
+        layout = (is_power_of_two(grid_size) && is_power_of_two(hill_size)) ? grid_layout::morton
+                                                                           : grid_layout::tiled;
+        // Padded to whole 32-bit words for the gathering test kernels.
+        cell_count = (layout == grid_layout::morton) ? grid_size * grid_size
+                                                     : hills.hills_per_side * hills.hills_per_side * hill_area;
+        cells.assign((cell_count + 3) & ~size_t(3), 0);
+    }
+
+    void clear()
+    {
+        cells.clear();
+        cell_count = 0;
+        hills = hill_geometry();
+    }
+
+    bool empty() const
+    {
+        return cells.empty();
+    }
+
+    size_t size() const
+    {
+        return hills.grid_size;
+    }
+
+    grid_layout get_layout() const
+    {
+        return layout;
+    }
+
+    size_t get_offset(size_t x, size_t y) const
+    {
+        if (layout == grid_layout::morton)
+            return get_morton_code(x, y);
+
+        const size_t quad_size = hills.quad_size;
+        return hills.get_hill_index(x, y) * hill_area + (y % quad_size) * quad_size + x % quad_size;
+    }
+
+    bool is_gold(size_t x, size_t y) const
+    {
+        return cells[get_offset(x, y)] != 0;
+    }
+
+    const unsigned char* get_cell_address(size_t x, size_t y) const
+    {
+        return cells.data() + get_offset(x, y);
+    }
+
+    std::uint64_t get_bit_address(size_t x, size_t y) const
+    {
+        return std::uint64_t(get_offset(x, y)) * 8;
+    }
+
+    size_t get_byte_count() const
+    {
+        return cells.size();
+    }
+    
+    std::uint64_t get_bit_count() const
+    {
+        return std::uint64_t(cells.size()) * 8;
+    }
+
+    void set(size_t x, size_t y, bool gold)
+    {
+        cells[get_offset(x, y)] = gold;
+    }
+
+    const unsigned char* get_data() const
+    {
+        return cells.data();
+    }
+
+    // Visits every cell in memory order, so generators write sequentially.
+    template <typename cell_writer>
+    void for_each_cell(cell_writer write)
+    {
+        if (layout == grid_layout::morton)
+        {
+            for (size_t i = 0; i < cell_count; ++i)
+                write(size_t(compact_bits(i)), size_t(compact_bits(i >> 1)), cells[i]);
+            return;
+        }
+
+        const size_t quad_size = hills.quad_size;
+        size_t i = 0;
+        for (size_t hill_y = 0; hill_y < hills.hills_per_side; ++hill_y)
+            for (size_t hill_x = 0; hill_x < hills.hills_per_side; ++hill_x)
+                for (size_t y = hill_y * quad_size; y < (hill_y + 1) * quad_size; ++y)
+                    for (size_t x = hill_x * quad_size; x < (hill_x + 1) * quad_size; ++x, ++i)
+                        if (x < hills.grid_size && y < hills.grid_size)
+                            write(x, y, cells[i]);
+    }
+};
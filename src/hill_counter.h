@@ -0,0 +1,396 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//--------------------------------------------------------------
+struct hill_count
+{
+    size_t index;
+    size_t count;
+    // How much count may overstate the true count.
+    size_t error;
+};
+
+//--------------------------------------------------------------
+// The space-saving heavy hitters algorithm: at most capacity hills are
+// tracked. A hill not yet tracked takes over the slot of the smallest one
+// and inherits its count as overestimate, so any hill counted more than
+// total / capacity times is guaranteed to be tracked. Slots are kept in a
+// min-heap on count, so finding the smallest is O(1) and every update is
+// O(log capacity).
+class space_saving_counter
+{
+private:
+    std::vector<hill_count> heap;
+    std::unordered_map<size_t, size_t> positions;
+    size_t capacity;
+
+    void swap_slots(size_t a, size_t b)
+    {
+        std::swap(heap[a], heap[b]);
+        positions[heap[a].index] = a;
+        positions[heap[b].index] = b;
+    }
+
+    void sift_up(size_t slot)
+    {
+        while (slot > 0 && heap[(slot - 1) / 2].count > heap[slot].count)
+        {
+            swap_slots(slot, (slot - 1) / 2);
+            slot = (slot - 1) / 2;
+        }
+    }
+
+    void sift_down(size_t slot)
+    {
+        for (;;)
+        {
+            const size_t left = slot * 2 + 1;
+            const size_t right = left + 1;
+            size_t smallest = slot;
+            if (left < heap.size() && heap[left].count < heap[smallest].count)
+                smallest = left;
+            if (right < heap.size() && heap[right].count < heap[smallest].count)
+                smallest = right;
+            if (smallest == slot)
+                return;
+            swap_slots(slot, smallest);
+            slot = smallest;
+        }
+    }
+
+public:
+    space_saving_counter() :
+        heap{},
+        positions{},
+        capacity{0}
+    {}
+
+    void reset(size_t slots)
+    {
+        capacity = std::max<size_t>(slots, 1);
+        heap.clear();
+        heap.reserve(capacity);
+        positions.clear();
+        positions.reserve(capacity);
+    }
+
+    void clear()
+    {
+        heap.clear();
+        positions.clear();
+    }
+
+    size_t size() const
+    {
+        return heap.size();
+    }
+
+    size_t add(size_t index)
+    {
+        const auto found = positions.find(index);
+        if (found != positions.end())
+        {
+            const size_t slot = found->second;
+            const size_t count = ++heap[slot].count;
+            sift_down(slot);
+            return count;
+        }
+
+        if (heap.size() < capacity)
+        {
+            heap.push_back({index, 1, 0});
+            positions[index] = heap.size() - 1;
+            sift_up(heap.size() - 1);
+            return 1;
+        }
+
+        // Evict the smallest, which is at the root.
+        positions.erase(heap[0].index);
+        heap[0] = {index, heap[0].count + 1, heap[0].count};
+        positions[index] = 0;
+        const size_t count = heap[0].count;
+        sift_down(0);
+        return count;
+    }
+
+    size_t get_count(size_t index) const
+    {
+        const auto found = positions.find(index);
+        return found != positions.end() ? heap[found->second].count : 0;
+    }
+
+    const std::vector<hill_count>& get_counts() const
+    {
+        return heap;
+    }
+};
+
+//--------------------------------------------------------------
+// A count-min sketch: depth rows of width counters, each row indexed by its
+// own hash of the hill. A hill's estimate is the smallest of its counters,
+// which never undercounts and overcounts by at most e / width of the total
+// with probability 1 - e^-depth. The sketch cannot list its hills, so the
+// heaviest candidates seen so far are kept beside it in a small min-heap.
+// Memory depends only on width, depth and the number of candidates.
+class count_min_sketch
+{
+private:
+    std::vector<std::uint32_t> counters;
+    std::vector<std::uint64_t> seeds;
+    std::vector<hill_count> candidates;
+    std::unordered_map<size_t, size_t> positions;
+    size_t log_width;
+    size_t candidate_capacity;
+
+    static std::uint64_t mix(std::uint64_t v)
+    {
+        v += 0x9e3779b97f4a7c15;
+        v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9;
+        v = (v ^ (v >> 27)) * 0x94d049bb133111eb;
+        return v ^ (v >> 31);
+    }
+
+    // Multiply-shift hashing into a power of two width.
+    size_t get_slot(size_t row, size_t index) const
+    {
+        const std::uint64_t hash = seeds[row] * (std::uint64_t(index) * 2 + 1);
+        return (row << log_width) + size_t(hash >> (64 - log_width));
+    }
+
+    void swap_slots(size_t a, size_t b)
+    {
+        std::swap(candidates[a], candidates[b]);
+        positions[candidates[a].index] = a;
+        positions[candidates[b].index] = b;
+    }
+
+    void sift_down(size_t slot)
+    {
+        for (;;)
+        {
+            const size_t left = slot * 2 + 1;
+            const size_t right = left + 1;
+            size_t smallest = slot;
+            if (left < candidates.size() && candidates[left].count < candidates[smallest].count)
+                smallest = left;
+            if (right < candidates.size() && candidates[right].count < candidates[smallest].count)
+                smallest = right;
+            if (smallest == slot)
+                return;
+            swap_slots(slot, smallest);
+            slot = smallest;
+        }
+    }
+
+    // Estimates only grow, so a candidate's slot can only move down the heap.
+    void offer(size_t index, size_t estimate)
+    {
+        const auto found = positions.find(index);
+        if (found != positions.end())
+        {
+            const size_t slot = found->second;
+            candidates[slot].count = estimate;
+            sift_down(slot);
+            return;
+        }
+
+        if (candidates.size() < candidate_capacity)
+        {
+            candidates.push_back({index, estimate, 0});
+            positions[index] = candidates.size() - 1;
+            for (size_t slot = candidates.size() - 1; slot > 0 && candidates[(slot - 1) / 2].count > candidates[slot].count; slot = (slot - 1) / 2)
+                swap_slots(slot, (slot - 1) / 2);
+        }
+        else if (estimate > candidates[0].count)
+        {
+            positions.erase(candidates[0].index);
+            candidates[0] = {index, estimate, 0};
+            positions[index] = 0;
+            sift_down(0);
+        }
+    }
+
+public:
+    count_min_sketch() :
+        counters{},
+        seeds{},
+        candidates{},
+        positions{},
+        log_width{1},
+        candidate_capacity{0}
+    {}
+
+    // The width is rounded up to a power of two, at least 2.
+    void reset(size_t width, size_t depth, size_t candidate_slots)
+    {
+        log_width = 1;
+        while ((size_t(1) << log_width) < width)
+            ++log_width;
+        depth = std::max<size_t>(depth, 1);
+        counters.assign(depth << log_width, 0);
+        seeds.resize(depth);
+        for (size_t row = 0; row < depth; ++row)
+            seeds[row] = mix(row) | 1;
+        candidate_capacity = std::max<size_t>(candidate_slots, 1);
+        candidates.clear();
+        candidates.reserve(candidate_capacity);
+        positions.clear();
+        positions.reserve(candidate_capacity);
+    }
+
+    void clear()
+    {
+        std::fill(counters.begin(), counters.end(), 0);
+        candidates.clear();
+        positions.clear();
+    }
+
+    size_t get_width() const
+    {
+        return size_t(1) << log_width;
+    }
+
+    size_t get_depth() const
+    {
+        return seeds.size();
+    }
+
+    // Leaves out the hash table's own bookkeeping for the candidate slots.
+    size_t get_memory_bytes() const
+    {
+        return counters.size() * sizeof(std::uint32_t) + seeds.size() * sizeof(std::uint64_t) +
+               candidate_capacity * (sizeof(hill_count) + sizeof(std::pair<const size_t, size_t>));
+    }
+
+    size_t add(size_t index)
+    {
+        std::uint32_t estimate = ~std::uint32_t(0);
+        for (size_t row = 0; row < seeds.size(); ++row)
+            estimate = std::min(estimate, ++counters[get_slot(row, index)]);
+        offer(index, estimate);
+        return estimate;
+    }
+
+    size_t get_count(size_t index) const
+    {
+        if (seeds.empty())
+            return 0;
+        std::uint32_t estimate = ~std::uint32_t(0);
+        for (size_t row = 0; row < seeds.size(); ++row)
+            estimate = std::min(estimate, counters[get_slot(row, index)]);
+        return estimate;
+    }
+
+    const std::vector<hill_count>& get_counts() const
+    {
+        return candidates;
+    }
+};
+
+//--------------------------------------------------------------
+enum class hill_counting
+{
+    exact,
+    top_k,
+    sketch
+};
+
+//--------------------------------------------------------------
+// Happy agents per hill for one iteration. Exact keeps every hill that has a
+// happy agent; top_k keeps a fixed number of heavy hitters and sketch a
+// count-min sketch, so for both memory does not grow with the number of
+// hills.
+class hill_counter
+{
+private:
+    hill_counting mode;
+    std::map<size_t, size_t> exact;
+    space_saving_counter heavy_hitters;
+    count_min_sketch sketch;
+
+public:
+    hill_counter() :
+        mode{hill_counting::exact},
+        exact{},
+        heavy_hitters{},
+        sketch{}
+    {}
+
+    // Capacity is the number of hills top_k tracks, or the number of
+    // candidates sketch keeps beside a width by depth sketch.
+    void reset(hill_counting counting, size_t capacity, size_t width = 1024, size_t depth = 4)
+    {
+        mode = counting;
+        exact.clear();
+        heavy_hitters.reset(mode == hill_counting::top_k ? capacity : 1);
+        sketch.reset(mode == hill_counting::sketch ? width : 1,
+                     mode == hill_counting::sketch ? depth : 1,
+                     mode == hill_counting::sketch ? capacity : 1);
+    }
+
+    const count_min_sketch& get_sketch() const
+    {
+        return sketch;
+    }
+
+    hill_counting get_mode() const
+    {
+        return mode;
+    }
+
+    void clear()
+    {
+        exact.clear();
+        heavy_hitters.clear();
+        if (mode == hill_counting::sketch)
+            sketch.clear();
+    }
+
+    // Counts one more happy agent on a hill, returning the hill's count.
+    size_t add(size_t index)
+    {
+        if (mode == hill_counting::top_k)
+            return heavy_hitters.add(index);
+        if (mode == hill_counting::sketch)
+            return sketch.add(index);
+        return ++exact[index];
+    }
+
+    size_t get_count(size_t index) const
+    {
+        if (mode == hill_counting::top_k)
+            return heavy_hitters.get_count(index);
+        if (mode == hill_counting::sketch)
+            return sketch.get_count(index);
+        const auto found = exact.find(index);
+        return found != exact.end() ? found->second : 0;
+    }
+
+    // The k hills with the most happy agents, most first.
+    std::vector<hill_count> get_top(size_t k) const
+    {
+        std::vector<hill_count> counts;
+        if (mode == hill_counting::top_k)
+            counts = heavy_hitters.get_counts();
+        else if (mode == hill_counting::sketch)
+            counts = sketch.get_counts();
+        else
+            for (const auto& hill : exact)
+                counts.push_back({hill.first, hill.second, 0});
+
+        k = std::min(k, counts.size());
+        std::partial_sort(counts.begin(), counts.begin() + k, counts.end(), [](const hill_count& lhs, const hill_count& rhs)
+        {
+            return lhs.count > rhs.count || (lhs.count == rhs.count && lhs.index < rhs.index);
+        });
+        counts.resize(k);
+        return counts;
+    }
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+
+//--------------------------------------------------------------
+// How the grid is cut into hills. Every geometry answers the same questions;
+// they differ only in how much is known at compile time, which decides
+// whether the divisions on the per-agent path stay divisions or become
+// shifts, masks and multiplies. Hill sizes need not divide the grid; the
+// last row and column of hills are then cut short by the edge of the world.
+struct hill_geometry
+{
+    size_t grid_size;
+    size_t quad_size;
+    size_t hills_per_side;
+
+    hill_geometry() :
+        grid_size{0},
+        quad_size{1},
+        hills_per_side{0}
+    {}
+
+    hill_geometry(size_t grid, size_t quad) :
+        grid_size{grid},
+        quad_size{quad},
+        hills_per_side{(grid + quad - 1) / quad}
+    {}
+
+    size_t get_grid_size() const
+    {
+        return grid_size;
+    }
+
+    size_t get_quad_size() const
+    {
+        return quad_size;
+    }
+
+    size_t get_quadrant_start(size_t v) const
+    {
+        return v - v % quad_size;
+    }
+
+    size_t get_hill_index(size_t x, size_t y) const
+    {
+        return x / quad_size + (y / quad_size) * hills_per_side;
+    }
+};
+
+//--------------------------------------------------------------
+inline bool is_power_of_two(size_t v)
+{
+    return v > 0 && (v & (v - 1)) == 0;
+}
+
+//--------------------------------------------------------------
+inline size_t get_log2(size_t v)
+{
+    size_t log = 0;
+    while (v > 1)
+    {
+        v >>= 1;
+        ++log;
+    }
+    return log;
+}
+
+//--------------------------------------------------------------
+// Any power of two grid and hill size, with the shifts worked out at runtime.
+struct power_of_two_hill_geometry
+{
+    size_t grid_size;
+    size_t quad_size;
+    size_t quad_shift;
+    size_t quad_mask;
+    size_t row_shift;
+
+    explicit power_of_two_hill_geometry(const hill_geometry& geometry) :
+        grid_size{geometry.grid_size},
+        quad_size{geometry.quad_size},
+        quad_shift{get_log2(geometry.quad_size)},
+        quad_mask{geometry.quad_size - 1},
+        row_shift{get_log2(geometry.hills_per_side)}
+    {}
+
+    size_t get_grid_size() const
+    {
+        return grid_size;
+    }
+
+    size_t get_quad_size() const
+    {
+        return quad_size;
+    }
+
+    size_t get_quadrant_start(size_t v) const
+    {
+        return v & ~quad_mask;
+    }
+
+    size_t get_hill_index(size_t x, size_t y) const
+    {
+        return (x >> quad_shift) + ((y >> quad_shift) << row_shift);
+    }
+};
+
+//--------------------------------------------------------------
+// Sizes fixed at compile time, so the compiler picks the cheapest arithmetic
+// and can unroll loops over a hill.
+template <size_t grid, size_t quad>
+struct fixed_hill_geometry
+{
+    static_assert(grid % quad == 0, "We need complete hills");
+
+    static constexpr size_t grid_size = grid;
+    static constexpr size_t quad_size = quad;
+    static constexpr size_t hills_per_side = grid / quad;
+
+    explicit fixed_hill_geometry(const hill_geometry&)
+    {}
+
+    constexpr size_t get_grid_size() const
+    {
+        return grid;
+    }
+
+    constexpr size_t get_quad_size() const
+    {
+        return quad;
+    }
+
+    constexpr size_t get_quadrant_start(size_t v) const
+    {
+        return v - v % quad;
+    }
+
+    constexpr size_t get_hill_index(size_t x, size_t y) const
+    {
+        return x / quad + (y / quad) * hills_per_side;
+    }
+};
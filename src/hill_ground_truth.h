@@ -0,0 +1,102 @@
+#pragma once
+
+#include "hill_geometry.h"
+#include "huge_page_allocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+//--------------------------------------------------------------
+// Gold counts of every axis aligned window of the world in constant time.
+// Entry (x, y) holds the number of gold cells above and to the left of it,
+// with a zero row and column in front. Counts are 32-bit, which covers worlds
+// up to 65535 cells a side.
+class summed_area_table
+{
+private:
+    std::vector<std::uint32_t, huge_page_allocator<std::uint32_t>> sums;
+    size_t stride;
+
+    template <typename task>
+    static void run_in_parallel(size_t count, task run)
+    {
+        const size_t thread_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), count));
+        const size_t chunk = (count + thread_count - 1) / thread_count;
+        std::vector<std::thread> threads;
+        for (size_t begin = 0; begin < count; begin += chunk)
+            threads.emplace_back(run, begin, std::min(begin + chunk, count));
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+public:
+    summed_area_table() :
+        sums{},
+        stride{0}
+    {}
+
+    // Prefix sums along each row, then down each column, both split over
+    // threads: rows by row, columns by bands of columns walked row by row.
+    template <typename world_type>
+    void build(const world_type& world, size_t grid_size)
+    {
+        stride = grid_size + 1;
+        sums.assign(stride * stride, 0);
+
+        run_in_parallel(grid_size, [&](size_t first, size_t last)
+        {
+            for (size_t y = first; y < last; ++y)
+            {
+                std::uint32_t* row = sums.data() + (y + 1) * stride;
+                std::uint32_t running = 0;
+                for (size_t x = 0; x < grid_size; ++x)
+                {
+                    running += world.is_gold(x, y);
+                    row[x + 1] = running;
+                }
+            }
+        });
+
+        run_in_parallel(stride, [&](size_t first, size_t last)
+        {
+            for (size_t y = 1; y < stride; ++y)
+            {
+                std::uint32_t* row = sums.data() + y * stride;
+                const std::uint32_t* above = row - stride;
+                for (size_t x = first; x < last; ++x)
+                    row[x] += above[x];
+            }
+        });
+    }
+
+    size_t size() const
+    {
+        return stride > 0 ? stride - 1 : 0;
+    }
+
+    // Gold cells in [x0, x1) by [y0, y1).
+    std::uint32_t count(size_t x0, size_t y0, size_t x1, size_t y1) const
+    {
+        return sums[y1 * stride + x1] - sums[y0 * stride + x1] - sums[y1 * stride + x0] + sums[y0 * stride + x0];
+    }
+};
+
+//--------------------------------------------------------------
+// Gold cells in every hill, indexed like hill_geometry::get_hill_index().
+inline std::vector<std::uint32_t> get_hill_counts(const summed_area_table& table,
+                                                  const hill_geometry& geometry)
+{
+    const size_t hills = geometry.hills_per_side;
+    const size_t quad_size = geometry.quad_size;
+    const size_t grid_size = table.size();
+    std::vector<std::uint32_t> counts(hills * hills);
+    for (size_t hill_y = 0; hill_y < hills; ++hill_y)
+        for (size_t hill_x = 0; hill_x < hills; ++hill_x)
+            counts[hill_x + hill_y * hills] = table.count(hill_x * quad_size,
+                                                          hill_y * quad_size,
+                                                          std::min((hill_x + 1) * quad_size, grid_size),
+                                                          std::min((hill_y + 1) * quad_size, grid_size));
+    return counts;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "sds_engine.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//--------------------------------------------------------------
+inline size_t get_greatest_common_divisor(size_t a, size_t b)
+{
+    while (b != 0)
+    {
+        const size_t remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+    return a;
+}
+
+//--------------------------------------------------------------
+// A 2D Fenwick tree: point updates and counts of any rectangle in
+// O(log^2 n), both without touching the cells in between.
+class fenwick_grid
+{
+private:
+    std::vector<std::int32_t> tree;
+    size_t side;
+
+    // Count in [0, x) by [0, y).
+    std::int64_t prefix(size_t x, size_t y) const
+    {
+        std::int64_t sum = 0;
+        for (size_t i = x; i > 0; i -= i & (~i + 1))
+            for (size_t j = y; j > 0; j -= j & (~j + 1))
+                sum += tree[(i - 1) * side + j - 1];
+        return sum;
+    }
+
+public:
+    fenwick_grid() :
+        tree{},
+        side{0}
+    {}
+
+    void resize(size_t size)
+    {
+        side = size;
+        tree.assign(size * size, 0);
+    }
+
+    size_t size() const
+    {
+        return side;
+    }
+
+    void add(size_t x, size_t y, std::int32_t delta)
+    {
+        for (size_t i = x + 1; i <= side; i += i & (~i + 1))
+            for (size_t j = y + 1; j <= side; j += j & (~j + 1))
+                tree[(i - 1) * side + j - 1] += delta;
+    }
+
+    // Count in [x0, x1) by [y0, y1), clipped to the grid.
+    std::int64_t count(size_t x0, size_t y0, size_t x1, size_t y1) const
+    {
+        x1 = std::min(x1, side);
+        y1 = std::min(y1, side);
+        return prefix(x1, y1) - prefix(x0, y1) - prefix(x1, y0) + prefix(x0, y0);
+    }
+};
+
+//--------------------------------------------------------------
+// Scores overlapping hills: square windows of window_size cells starting
+// every stride cells, so a cluster straddling a fixed hill boundary still
+// falls inside one window. Happy agents are counted in a Fenwick tree of
+// buckets, where the bucket size divides both the window size and the
+// stride. Each iteration only agents whose bucket changed update the tree,
+// and only windows holding at least one happy agent are scored.
+class hill_windows
+{
+public:
+    struct window
+    {
+        size_t x = 0;
+        size_t y = 0;
+        std::int64_t count = 0;
+    };
+
+private:
+    fenwick_grid counts;
+    std::vector<size_t> counted;
+    size_t window_size;
+    size_t stride;
+    size_t bucket_size;
+    size_t bucket_count;
+
+    enum : size_t { not_counted = ~size_t(0) };
+
+public:
+    hill_windows() :
+        counts{},
+        counted{},
+        window_size{1},
+        stride{1},
+        bucket_size{1},
+        bucket_count{0}
+    {}
+
+    void reset(size_t grid_size, size_t size, size_t window_stride)
+    {
+        window_size = std::max<size_t>(size, 1);
+        stride = std::max<size_t>(window_stride, 1);
+        bucket_size = get_greatest_common_divisor(window_size, stride);
+        bucket_count = (grid_size + bucket_size - 1) / bucket_size;
+        counts.resize(bucket_count);
+        counted.clear();
+    }
+
+    bool empty() const
+    {
+        return bucket_count == 0;
+    }
+
+    // Brings the counts up to date with which agents are happy and where.
+    void update(const std::vector<std::shared_ptr<agent>>& agents)
+    {
+        counted.resize(agents.size(), not_counted);
+        for (size_t i = 0; i < agents.size(); ++i)
+        {
+            const agent& a = *agents[i];
+            const size_t bucket = a.happy ? (a.y / bucket_size) * bucket_count + a.x / bucket_size : not_counted;
+            if (bucket == counted[i])
+                continue;
+            if (counted[i] != not_counted)
+                counts.add(counted[i] % bucket_count, counted[i] / bucket_count, -1);
+            if (bucket != not_counted)
+                counts.add(bucket % bucket_count, bucket / bucket_count, 1);
+            counted[i] = bucket;
+        }
+    }
+
+    std::int64_t get_count(size_t x, size_t y) const
+    {
+        const size_t first_x = x / bucket_size;
+        const size_t first_y = y / bucket_size;
+        const size_t span = window_size / bucket_size;
+        return counts.count(first_x, first_y, first_x + span, first_y + span);
+    }
+
+    // The window holding the most happy agents.
+    window get_best_window() const
+    {
+        window best;
+        for (const size_t bucket : counted)
+        {
+            if (bucket == not_counted)
+                continue;
+            // Every window start, a multiple of the stride, that covers this bucket.
+            const size_t cell_x = (bucket % bucket_count) * bucket_size;
+            const size_t cell_y = (bucket / bucket_count) * bucket_size;
+            const size_t first_x = cell_x + 1 > window_size ? (cell_x + 1 - window_size + stride - 1) / stride : 0;
+            const size_t first_y = cell_y + 1 > window_size ? (cell_y + 1 - window_size + stride - 1) / stride : 0;
+            for (size_t start_y = first_y * stride; start_y <= cell_y; start_y += stride)
+            {
+                for (size_t start_x = first_x * stride; start_x <= cell_x; start_x += stride)
+                {
+                    const std::int64_t count = get_count(start_x, start_y);
+                    if (count > best.count)
+                    {
+                        best.x = start_x;
+                        best.y = start_y;
+                        best.count = count;
+                    }
+                }
+            }
+        }
+        return best;
+    }
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+//--------------------------------------------------------------
+// Large buffers that are read at random (the world, the occupancy stamps,
+// the agents) miss the TLB on nearly every access with 4KB pages. Allocations
+// of at least one huge page first ask for explicit huge pages (MAP_HUGETLB),
+// which only succeeds if the administrator reserved some. Failing that they
+// get an ordinary mapping aligned to the huge page size and marked
+// MADV_HUGEPAGE, so transparent huge pages can back it. Smaller allocations,
+// and everything off Linux, use operator new.
+const size_t huge_page_size = size_t(2) << 20;
+
+//--------------------------------------------------------------
+inline size_t get_huge_page_length(size_t bytes)
+{
+    return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+}
+
+//--------------------------------------------------------------
+inline void* allocate_huge_pages(size_t bytes)
+{
+#if defined(__linux__)
+    const size_t length = get_huge_page_length(bytes);
+    void* explicit_pages = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (explicit_pages != MAP_FAILED)
+        return explicit_pages;
+
+    // Over-allocate by a huge page so the start can be aligned, then trim.
+    void* mapping = mmap(nullptr, length + huge_page_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+        throw std::bad_alloc();
+
+    const std::uintptr_t start = reinterpret_cast<std::uintptr_t>(mapping);
+    const std::uintptr_t aligned = (start + huge_page_size - 1) & ~std::uintptr_t(huge_page_size - 1);
+    if (aligned > start)
+        munmap(mapping, aligned - start);
+    munmap(reinterpret_cast<void*>(aligned + length), start + huge_page_size - aligned);
+    madvise(reinterpret_cast<void*>(aligned), length, MADV_HUGEPAGE);
+    return reinterpret_cast<void*>(aligned);
+#else
+    return ::operator new(bytes);
+#endif
+}
+
+//--------------------------------------------------------------
+inline void free_huge_pages(void* data, size_t bytes)
+{
+#if defined(__linux__)
+    munmap(data, get_huge_page_length(bytes));
+#else
+    (void)bytes;
+    ::operator delete(data);
+#endif
+}
+
+//--------------------------------------------------------------
+template <typename T>
+class huge_page_allocator
+{
+public:
+    typedef T value_type;
+
+    huge_page_allocator() = default;
+
+    template <typename U>
+    huge_page_allocator(const huge_page_allocator<U>&) {}
+
+    T* allocate(size_t count)
+    {
+        const size_t bytes = count * sizeof(T);
+        if (bytes < huge_page_size)
+            return static_cast<T*>(::operator new(bytes));
+        return static_cast<T*>(allocate_huge_pages(bytes));
+    }
+
+    void deallocate(T* data, size_t count)
+    {
+        const size_t bytes = count * sizeof(T);
+        if (bytes < huge_page_size)
+            ::operator delete(data);
+        else
+            free_huge_pages(data, bytes);
+    }
+
+    template <typename U>
+    bool operator==(const huge_page_allocator<U>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const huge_page_allocator<U>&) const { return false; }
+};
+
+//--------------------------------------------------------------
+// Looks up the mapping holding a buffer in /proc/self/smaps and describes how
+// much of it is on huge pages, e.g. "world: 4096 of 4096 kB on huge pages
+// (transparent)".
+inline std::string describe_huge_pages(const std::string& name, const void* data, size_t bytes)
+{
+    std::ostringstream description;
+    description << name << ": ";
+#if defined(__linux__)
+    std::ifstream smaps("/proc/self/smaps");
+    const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(data);
+    std::string line;
+    bool found = false;
+    size_t size_kb = 0;
+    size_t transparent_kb = 0;
+    size_t explicit_kb = 0;
+    while (std::getline(smaps, line))
+    {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        const size_t dash = key.find('-');
+        if (dash != std::string::npos && key.back() != ':')
+        {
+            if (found)
+                break;
+            const std::uintptr_t begin = std::stoull(key.substr(0, dash), nullptr, 16);
+            const std::uintptr_t end = std::stoull(key.substr(dash + 1), nullptr, 16);
+            found = address >= begin && address < end;
+        }
+        else if (found)
+        {
+            size_t kb = 0;
+            fields >> kb;
+            if (key == "Size:")
+                size_kb = kb;
+            else if (key == "AnonHugePages:")
+                transparent_kb = kb;
+            else if (key == "Private_Hugetlb:" || key == "Shared_Hugetlb:")
+                explicit_kb += kb;
+        }
+    }
+
+    if (!found || bytes < huge_page_size)
+        description << bytes / 1024 << " kB, not on huge pages";
+    else if (explicit_kb > 0)
+        description << explicit_kb << " of " << size_kb << " kB on huge pages (explicit)";
+    else
+        description << transparent_kb << " of " << size_kb << " kB on huge pages (transparent)";
+#else
+    description << bytes / 1024 << " kB, huge pages not supported";
+#endif
+    return description.str();
+}
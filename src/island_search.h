@@ -0,0 +1,300 @@
+#pragma once
+
+#include "sds_engine.h"
+#include "spsc_queue.h"
+#include "numa_placement.h"
+
+#include <array>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+//--------------------------------------------------------------
+// Several independent populations searching the same world, one thread each.
+// Every migration_interval iterations an island sends the positions of a
+// fraction of its happy agents to the next island in a ring, through a
+// lock-free queue, and the receiving island moves unhappy agents onto them.
+// Nothing else is shared while the islands run. Islands are dealt out over
+// the NUMA nodes; each island's thread is pinned to its node and builds its
+// own population there, so agents stay local to the thread that reads them.
+// The threads live as long as the islands and wait for work between runs.
+class island_search
+{
+private:
+    struct island
+    {
+        sds_population population;
+        spsc_queue<std::array<size_t, 2>> arrivals;
+        unsigned long long iteration = 0;
+        size_t best_index = 0;
+        size_t best_count = 0;
+        unsigned long long emigrants = 0;
+        unsigned long long immigrants = 0;
+        int node = 0;
+
+        // The queue is cache line aligned, which plain new only honours
+        // from C++17.
+        static void* operator new(size_t bytes)
+        {
+#if defined(_WIN32)
+            void* data = _aligned_malloc(bytes, alignof(island));
+#else
+            void* data = nullptr;
+            if (posix_memalign(&data, alignof(island), bytes) != 0)
+                data = nullptr;
+#endif
+            if (data == nullptr)
+                throw std::bad_alloc();
+            return data;
+        }
+
+        static void operator delete(void* data)
+        {
+#if defined(_WIN32)
+            _aligned_free(data);
+#else
+            std::free(data);
+#endif
+        }
+    };
+
+    std::vector<std::unique_ptr<island>> islands;
+    size_t migration_interval;
+    float migration_fraction;
+
+    std::vector<std::thread> workers;
+    std::mutex work_mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    std::function<void(size_t)> work;
+    unsigned long long generation;
+    size_t pending;
+    bool stopping;
+
+    // Worker index serves island index. It pins itself to the island's node
+    // once, then runs each piece of work handed out after the generation it
+    // was started at on its island.
+    void run_worker(size_t index, unsigned long long done)
+    {
+        pin_thread_to_numa_node(islands[index]->node);
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(work_mutex);
+                work_ready.wait(lock, [&]() { return stopping || generation != done; });
+                if (stopping)
+                    return;
+                done = generation;
+            }
+            work(index);
+            std::lock_guard<std::mutex> lock(work_mutex);
+            if (--pending == 0)
+                work_done.notify_one();
+        }
+    }
+
+    // Runs job(i) for every island on its worker and waits for all of them.
+    void run_on_workers(const std::function<void(size_t)>& job)
+    {
+        std::unique_lock<std::mutex> lock(work_mutex);
+        work = job;
+        pending = workers.size();
+        ++generation;
+        work_ready.notify_all();
+        work_done.wait(lock, [&]() { return pending == 0; });
+    }
+
+    void stop_workers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(work_mutex);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+        workers.clear();
+        stopping = false;
+        work = nullptr;
+        pending = 0;
+    }
+
+    static void settle_arrivals(island& home)
+    {
+        std::array<size_t, 2> position;
+        for (auto& agent : home.population.agents)
+        {
+            if (agent->happy)
+                continue;
+            if (!home.arrivals.try_pop(position))
+                break;
+            agent->x = position[0];
+            agent->y = position[1];
+            agent->moved = true;
+            ++home.immigrants;
+        }
+    }
+
+    static void send_emigrants(island& home, island& next, float fraction)
+    {
+        const auto& happy_agents = home.population.happy_agents;
+        const size_t count = size_t(float(happy_agents.size()) * fraction);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!next.arrivals.try_push({happy_agents[i]->x, happy_agents[i]->y}))
+                break;
+            ++home.emigrants;
+        }
+    }
+
+    template <typename world_type>
+    void run_island(size_t index,
+                    const world_type& world,
+                    bool world_changed,
+                    size_t iterations,
+                    const sds_phases& phases,
+                    const hill_geometry& geometry)
+    {
+        island& home = *islands[index];
+        island& next = *islands[(index + 1) % islands.size()];
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            settle_arrivals(home);
+            begin_iteration(home.population);
+            test_population(home.population, world, world_changed && i == 0);
+            home.best_index = finish_iteration(home.population, phases, geometry);
+            home.best_count = home.population.hill_indices.get_count(home.best_index);
+
+            if (++home.iteration % migration_interval == 0 && islands.size() > 1)
+                send_emigrants(home, next, migration_fraction);
+        }
+    }
+
+public:
+    island_search() :
+        islands{},
+        migration_interval{10},
+        migration_fraction{0.1f},
+        workers{},
+        work_mutex{},
+        work_ready{},
+        work_done{},
+        work{},
+        generation{0},
+        pending{0},
+        stopping{false}
+    {}
+
+    ~island_search()
+    {
+        stop_workers();
+    }
+
+    void reset(size_t island_count,
+               size_t agents_per_island,
+               size_t grid_size,
+               size_t interval,
+               float fraction)
+    {
+        stop_workers();
+        islands.clear();
+        const int nodes = get_numa_node_count();
+        for (size_t i = 0; i < island_count; ++i)
+        {
+            islands.emplace_back(new island());
+            islands.back()->node = int(i % size_t(nodes));
+        }
+
+        // Only once islands stops growing may workers hold on to its islands.
+        // New workers start at the current generation, so none of them picks
+        // up work handed out to the workers they replace.
+        for (size_t i = 0; i < islands.size(); ++i)
+            workers.emplace_back(&island_search::run_worker, this, i, generation);
+        run_on_workers([this, agents_per_island, grid_size](size_t i)
+        {
+            reset_population(islands[i]->population, agents_per_island, grid_size);
+        });
+        migration_interval = std::max<size_t>(interval, 1);
+        migration_fraction = fraction;
+    }
+
+    void clear()
+    {
+        stop_workers();
+        islands.clear();
+    }
+
+    size_t size() const
+    {
+        return islands.size();
+    }
+
+    const sds_population& get_population(size_t index) const
+    {
+        return islands[index]->population;
+    }
+
+    // Runs every island for the given number of iterations in parallel and
+    // returns the best hill across all of them.
+    template <typename world_type>
+    size_t run(const world_type& world,
+               bool world_changed,
+               size_t iterations,
+               const sds_phases& phases,
+               const hill_geometry& geometry)
+    {
+        run_on_workers([&](size_t i)
+        {
+            run_island(i, world, world_changed, iterations, phases, geometry);
+        });
+        return get_best_hill();
+    }
+
+    // Each island votes for its own best hill with the number of agents on it.
+    size_t get_best_hill() const
+    {
+        std::map<size_t, size_t> votes;
+        size_t best_index = 0;
+        size_t best_votes = 0;
+        for (const auto& home : islands)
+        {
+            const size_t total = votes[home->best_index] += home->best_count;
+            if (total > best_votes)
+            {
+                best_votes = total;
+                best_index = home->best_index;
+            }
+        }
+        return best_index;
+    }
+
+    // Where each island's agents actually live relative to its node.
+    numa_locality get_numa_report() const
+    {
+        numa_locality report;
+        std::vector<const void*> addresses;
+        for (const auto& home : islands)
+        {
+            addresses.clear();
+            addresses.push_back(home->population.agents.data());
+            for (const auto& agent : home->population.agents)
+                addresses.push_back(agent.get());
+            report += get_numa_locality(addresses, home->node);
+        }
+        return report;
+    }
+    
+    unsigned long long get_migrations() const
+    {
+        unsigned long long migrations = 0;
+        for (const auto& home : islands)
+            migrations += home->immigrants;
+        return migrations;
+    }
+};
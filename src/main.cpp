@@ -1,8 +1,294 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "distributed_search.h"
+#include "sds_benchmarks.h"
+#include "hill_ground_truth.h"
+#include "baseline_search.h"
+#include "pyramid_search.h"
+#include "continuous_sds.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+//========================================================================
+// --distributed [workers] [agents per worker] [iterations] runs headless over
+// the world file written with 'w', one worker process per partition.
+int run_distributed(int argc, char* argv[]){
+	const size_t workers = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+	const size_t agents = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 100;
+	const size_t iterations = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 100;
+
+	const distributed_report report = run_distributed_search(ofToDataPath("world.sdsw"), workers, agents, iterations);
+	if (!report.ok){
+		ofLogError("distributed") << "Search failed, write a world with 'w' first";
+		return 1;
+	}
+	ofLogNotice("distributed") << workers << " workers, " << iterations << " iterations in " << report.seconds
+							   << "s, best hill " << report.best_hill << " (" << report.best_count << " agents), "
+							   << report.communication_seconds_per_iteration * 1e6 << "us exchange per iteration, "
+							   << report.recruited << " recruited across workers";
+	return 0;
+}
+
+//========================================================================
+// --lattice [agents] [max iterations] [fraction] times how long each
+// communication topology takes until the best hill holds that fraction of
+// the agents, over the world file written with 'w'.
+int run_lattice(int argc, char* argv[]){
+	const size_t agents = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000;
+	const size_t max_iterations = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1000;
+	const float fraction = argc > 4 ? std::strtof(argv[4], nullptr) : 0.5f;
+
+	mapped_world world;
+	if (!world.open(ofToDataPath("world.sdsw"))){
+		ofLogError("lattice") << "Could not map the world, write one with 'w' first";
+		return 1;
+	}
+	const hill_geometry geometry(world.grid_size(), world.partial_size());
+	const sds_phases phases = get_sds_phases(geometry.grid_size, geometry.quad_size);
+
+	for (const auto topology : {communication_topology::full,
+								communication_topology::ring,
+								communication_topology::torus,
+								communication_topology::small_world}){
+		sds_population population;
+		population.lattice.topology = topology;
+		reset_population(population, agents, geometry.grid_size);
+		const convergence_result result = run_until_converged(population, world.view(), phases, geometry, max_iterations, fraction);
+		ofLogNotice("lattice") << get_topology_name(topology) << ": "
+							   << (result.converged ? "converged" : "did not converge") << " after "
+							   << result.iterations << " iterations in " << result.seconds << "s, best hill "
+							   << result.best_hill << " (" << result.best_count << " agents)";
+	}
+	return 0;
+}
+
+//========================================================================
+void log_accuracy(const std::string& method, std::vector<accuracy_result> results){
+	std::sort(results.begin(), results.end(), [](const accuracy_result& lhs, const accuracy_result& rhs){
+		return !lhs.correct < !rhs.correct || (lhs.correct == rhs.correct && lhs.seconds < rhs.seconds);
+	});
+	size_t correct = 0;
+	size_t iterations = 0;
+	size_t tests = 0;
+	for (const auto& result : results){
+		correct += result.correct;
+		iterations += result.correct ? result.iterations : 0;
+		tests += result.correct ? result.tests : 0;
+	}
+	if (correct == 0){
+		ofLogNotice("accuracy") << method << ": no seed found the best hill";
+		return;
+	}
+	ofLogNotice("accuracy") << method << ": " << correct << " of " << results.size() << " seeds correct, mean "
+							<< iterations / correct << " iterations (" << tests / correct
+							<< " tests), median " << results[(correct - 1) / 2].seconds << "s, worst "
+							<< results[correct - 1].seconds << "s";
+}
+
+//========================================================================
+// --accuracy [agents] [seeds] [max iterations] finds the true best hill of the
+// world file with a summed-area table, then times how long SDS takes to settle
+// on it from each seed, against random sampling with the same tests per
+// iteration, a coarse to fine pyramid of hills, the same search built on
+// sds_core and an exhaustive scan of both the packed and in-memory worlds.
+int run_accuracy(int argc, char* argv[]){
+	const size_t agents = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+	const size_t seeds = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 20;
+	const size_t max_iterations = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 10000;
+	const size_t stable_iterations = 10;
+
+	mapped_world world;
+	if (!world.open(ofToDataPath("world.sdsw"))){
+		ofLogError("accuracy") << "Could not map the world, write one with 'w' first";
+		return 1;
+	}
+	const hill_geometry geometry(world.grid_size(), world.partial_size());
+	const sds_phases phases = get_sds_phases(geometry.grid_size, geometry.quad_size);
+	const packed_world_view view = world.view();
+
+	const auto start = std::chrono::steady_clock::now();
+	summed_area_table table;
+	table.build(view, geometry.grid_size);
+	const std::vector<std::uint32_t> hill_counts = get_hill_counts(table, geometry);
+	const double table_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const size_t true_best = size_t(std::max_element(hill_counts.begin(), hill_counts.end()) - hill_counts.begin());
+	ofLogNotice("accuracy") << "true best hill " << true_best << " (" << hill_counts[true_best] << " gold cells), found in "
+							<< table_seconds << "s";
+
+	// Random sampling tests agents cells per round, while SDS only retests the
+	// agents that moved, so each runner reports the tests it really made.
+	std::vector<accuracy_result> sds_results;
+	std::vector<accuracy_result> sampling_results;
+	std::vector<accuracy_result> pyramid_results;
+	std::vector<accuracy_result> core_results;
+	for (size_t seed = 0; seed < seeds; ++seed){
+		sds_population population;
+		population.uniform_random.seed(unsigned(seed));
+		reset_population(population, agents, geometry.grid_size);
+		sds_results.push_back(run_until_correct(population, view, phases, geometry, hill_counts,
+												max_iterations, stable_iterations));
+
+		random_uniform sampling_random;
+		sampling_random.seed(unsigned(seed));
+		sampling_results.push_back(run_sampling_until_correct(view, geometry, hill_counts, sampling_random,
+															  agents, max_iterations, stable_iterations));
+
+		pyramid_search pyramid;
+		pyramid.get_population().uniform_random.seed(unsigned(seed));
+		pyramid.reset(geometry.grid_size, geometry.quad_size, 4, agents);
+		const auto pyramid_start = std::chrono::steady_clock::now();
+		const pyramid_result found = pyramid.run(view, max_iterations, stable_iterations);
+		accuracy_result result;
+		result.correct = hill_counts[found.hill_index] == hill_counts[true_best];
+		result.iterations = found.iterations;
+		result.tests = found.tests;
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - pyramid_start).count();
+		pyramid_results.push_back(result);
+
+		gold_grid_sds<packed_world_view> core;
+		core.get_random().seed(unsigned(seed));
+		core.get_test().reset(view);
+		core.get_recruitment().reset(geometry);
+		core.reset(agents);
+		core_results.push_back(run_until_correct(core, hill_counts, max_iterations, stable_iterations));
+	}
+	log_accuracy("sds", sds_results);
+	log_accuracy("random sampling", sampling_results);
+	log_accuracy("pyramid", pyramid_results);
+	log_accuracy("sds core", core_results);
+
+	const auto scan_start = std::chrono::steady_clock::now();
+	const std::vector<std::uint32_t> scanned = scan_hill_counts(view, geometry);
+	const double scan_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - scan_start).count();
+	ofLogNotice("accuracy") << "exhaustive scan: " << (scanned == hill_counts ? "correct" : "wrong") << " after "
+							<< geometry.grid_size * geometry.grid_size << " tests in " << scan_seconds << "s";
+
+	// The same scan over the one byte per cell world the app searches in memory.
+	grid_world in_memory;
+	in_memory.resize(geometry.grid_size, geometry.quad_size);
+	for (size_t y = 0; y < geometry.grid_size; ++y)
+		for (size_t x = 0; x < geometry.grid_size; ++x)
+			in_memory.set(x, y, view.is_gold(x, y));
+	const auto memory_scan_start = std::chrono::steady_clock::now();
+	const std::vector<std::uint32_t> memory_scanned = scan_hill_counts(in_memory, geometry);
+	const double memory_scan_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - memory_scan_start).count();
+	ofLogNotice("accuracy") << "exhaustive scan in memory: " << (memory_scanned == hill_counts ? "correct" : "wrong")
+							<< " after " << geometry.grid_size * geometry.grid_size << " tests in " << memory_scan_seconds << "s";
+	return 0;
+}
+
+//========================================================================
+// --sketch [agents] [width] [depth] [iterations] counts hills with a
+// count-min sketch and reports how often its best hill agrees with an exact
+// count of the same agents, over the world file written with 'w'.
+int run_sketch(int argc, char* argv[]){
+	const size_t agents = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000;
+	const size_t width = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1024;
+	const size_t depth = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 4;
+	const size_t iterations = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 1000;
+
+	mapped_world world;
+	if (!world.open(ofToDataPath("world.sdsw"))){
+		ofLogError("sketch") << "Could not map the world, write one with 'w' first";
+		return 1;
+	}
+	const hill_geometry geometry(world.grid_size(), world.partial_size());
+	const sds_phases phases = get_sds_phases(geometry.grid_size, geometry.quad_size);
+
+	sds_population population;
+	population.hill_indices.reset(hill_counting::sketch, 16, width, depth);
+	reset_population(population, agents, geometry.grid_size);
+
+	hill_counter exact;
+	size_t agreements = 0;
+	size_t most_hills = 0;
+	for (size_t i = 0; i < iterations; ++i){
+		begin_iteration(population);
+		test_population(population, world.view(), i == 0);
+		const size_t estimated_best = finish_iteration(population, phases, geometry);
+
+		exact.clear();
+		size_t exact_best = 0;
+		for (const auto& happy : population.happy_agents)
+			exact_best = std::max(exact_best, exact.add(geometry.get_hill_index(happy->x, happy->y)));
+		agreements += exact.get_count(estimated_best) == exact_best;
+		most_hills = std::max(most_hills, exact.get_top(~size_t(0)).size());
+	}
+
+	const count_min_sketch& sketch = population.hill_indices.get_sketch();
+	ofLogNotice("sketch") << sketch.get_width() << " x " << sketch.get_depth() << " sketch (" << sketch.get_memory_bytes()
+						  << " bytes) agreed with the exact best hill on " << agreements << " of " << iterations
+						  << " iterations; the exact count needed up to " << most_hills << " hills of "
+						  << geometry.hills_per_side * geometry.hills_per_side;
+	return 0;
+}
+
+//========================================================================
+// --continuous [agents] [weights] [iterations] tunes the weights of a linear
+// model with continuous SDS, from random samples of a model with known
+// weights, and reports how far the best agent is from them.
+int run_continuous(int argc, char* argv[]){
+	const size_t agents = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4096;
+	const size_t dimensions = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 8;
+	const size_t iterations = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 2000;
+	const size_t samples = 256;
+
+	std::mt19937 random_number_generator(1);
+	std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+	std::vector<float> weights(dimensions);
+	for (auto& weight : weights)
+		weight = uniform(random_number_generator);
+
+	linear_fit_objective objective;
+	objective.reset(dimensions);
+	std::vector<float> features(dimensions);
+	for (size_t s = 0; s < samples; ++s){
+		float target = 0.0f;
+		for (size_t d = 0; d < dimensions; ++d){
+			features[d] = uniform(random_number_generator);
+			target += features[d] * weights[d];
+		}
+		objective.add_sample(features, target);
+	}
+
+	continuous_sds<linear_fit_objective> search;
+	search.reset(objective, agents, std::vector<float>(dimensions, -2.0f), std::vector<float>(dimensions, 2.0f), 0.005f, 1);
+	size_t happy = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < iterations; ++i)
+		happy = search.iterate();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<float> best;
+	const float loss = search.get_best(best);
+	float largest_error = 0.0f;
+	for (size_t d = 0; d < dimensions; ++d)
+		largest_error = std::max(largest_error, std::abs(best[d] - weights[d]));
+	ofLogNotice("continuous") << agents << " agents, " << dimensions << " weights: " << iterations << " iterations in "
+							  << seconds << "s, " << happy << " happy, best loss " << loss
+							  << ", largest weight error " << largest_error;
+	return 0;
+}
 
 //========================================================================
-int main( ){
+int main(int argc, char* argv[]){
+	if (argc > 1 && std::string(argv[1]) == "--distributed")
+		return run_distributed(argc, argv);
+	if (argc > 1 && std::string(argv[1]) == "--lattice")
+		return run_lattice(argc, argv);
+	if (argc > 1 && std::string(argv[1]) == "--accuracy")
+		return run_accuracy(argc, argv);
+	if (argc > 1 && std::string(argv[1]) == "--sketch")
+		return run_sketch(argc, argv);
+	if (argc > 1 && std::string(argv[1]) == "--continuous")
+		return run_continuous(argc, argv);
+
 	ofSetupOpenGL(600, 600, OF_WINDOW);			// <-------- setup the GL context
 
 	// this kicks off the running of my app
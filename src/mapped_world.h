@@ -0,0 +1,213 @@
+#pragma once
+
+#include "world_file.h"
+
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//--------------------------------------------------------------
+// Read-only access to world bits stored in the world file tile layout,
+// wherever those bits happen to live.
+struct packed_world_view
+{
+    const unsigned char* data = nullptr;
+    size_t grid_size = 0;
+    size_t tile_size = 0;
+    size_t tiles_per_side = 0;
+    size_t tile_bytes = 0;
+
+    packed_world_view() = default;
+
+    packed_world_view(const unsigned char* bits, size_t grid, size_t tile) :
+        data{bits},
+        grid_size{grid},
+        tile_size{tile},
+        tiles_per_side{get_tiles_per_side(grid, tile)},
+        tile_bytes{get_tile_bytes(tile)}
+    {}
+
+    size_t get_byte_offset(size_t x, size_t y) const
+    {
+        return get_tile_index(x, y, tile_size, tiles_per_side) * tile_bytes +
+               get_bit_in_tile(x, y, tile_size) / 8;
+    }
+
+    const unsigned char* get_data() const
+    {
+        return data;
+    }
+
+    const unsigned char* get_cell_address(size_t x, size_t y) const
+    {
+        return data + get_byte_offset(x, y);
+    }
+
+    std::uint64_t get_bit_address(size_t x, size_t y) const
+    {
+        return std::uint64_t(get_byte_offset(x, y)) * 8 + get_bit_in_tile(x, y, tile_size) % 8;
+    }
+
+    std::uint64_t get_bit_count() const
+    {
+        return std::uint64_t(tiles_per_side) * tiles_per_side * tile_bytes * 8;
+    }
+
+    bool is_gold(size_t x, size_t y) const
+    {
+        const size_t bit = get_bit_in_tile(x, y, tile_size);
+        return (data[get_byte_offset(x, y)] >> (bit % 8)) & 1;
+    }
+};
+
+//--------------------------------------------------------------
+// A whole file mapped read-only into memory.
+class mapped_file
+{
+private:
+    int file;
+    void* mapping;
+    size_t mapping_size;
+
+public:
+    mapped_file() :
+        file{-1},
+        mapping{nullptr},
+        mapping_size{0}
+    {}
+
+    ~mapped_file()
+    {
+        close();
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    bool open(const std::string& path)
+    {
+        close();
+        file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+
+        struct stat status;
+        if (fstat(file, &status) != 0 || status.st_size <= 0)
+        {
+            close();
+            return false;
+        }
+
+        mapping_size = size_t(status.st_size);
+        mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, file, 0);
+        if (mapping == MAP_FAILED)
+        {
+            mapping = nullptr;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (mapping != nullptr)
+            munmap(mapping, mapping_size);
+        if (file >= 0)
+            ::close(file);
+        mapping = nullptr;
+        mapping_size = 0;
+        file = -1;
+    }
+
+    bool is_open() const
+    {
+        return mapping != nullptr;
+    }
+
+    const unsigned char* data() const
+    {
+        return static_cast<const unsigned char*>(mapping);
+    }
+
+    size_t size() const
+    {
+        return mapping_size;
+    }
+
+    void advise(int advice) const
+    {
+        if (mapping != nullptr)
+            madvise(mapping, mapping_size, advice);
+    }
+};
+
+//--------------------------------------------------------------
+// A world file mapped read-only into memory. Opening is instant regardless of
+// world size and every process mapping the same file shares its page cache.
+class mapped_world
+{
+private:
+    mapped_file file;
+    world_file_header header;
+
+public:
+    mapped_world() :
+        file{},
+        header{}
+    {}
+
+    bool open(const std::string& path)
+    {
+        close();
+        if (!file.open(path) || file.size() < sizeof(world_file_header))
+        {
+            close();
+            return false;
+        }
+
+        std::memcpy(&header, file.data(), sizeof(header));
+        const size_t tiles_per_side = get_tiles_per_side(header.grid_size, header.tile_size);
+        if (!is_valid_world_header(header) ||
+            header.data_offset + tiles_per_side * tiles_per_side * get_tile_bytes(header.tile_size) > file.size())
+        {
+            close();
+            return false;
+        }
+
+        // Agents read scattered cells, so read-ahead would mostly be wasted.
+        file.advise(MADV_RANDOM);
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        header = world_file_header{};
+    }
+
+    bool is_open() const
+    {
+        return file.is_open();
+    }
+
+    size_t grid_size() const
+    {
+        return header.grid_size;
+    }
+
+    size_t partial_size() const
+    {
+        return header.partial_size;
+    }
+
+    packed_world_view view() const
+    {
+        return packed_world_view(file.data() + header.data_offset,
+                                 header.grid_size,
+                                 header.tile_size);
+    }
+};
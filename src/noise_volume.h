@@ -0,0 +1,172 @@
+#pragma once
+
+#include "ofMain.h"
+#include "mapped_world.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------
+// The thresholded moving noise world for a fixed number of iterations, baked
+// once into a file of packed slices (one world file tile layout per
+// iteration) and mapped back in. The header records every parameter that
+// shapes the noise, so a cache built with different settings is rebuilt.
+struct noise_volume_header
+{
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t grid_size;
+    std::uint64_t tile_size;
+    std::uint64_t iterations;
+    float scale;
+    float speed;
+    float threshold;
+    std::uint32_t padding;
+    std::uint64_t data_offset;
+};
+
+const char noise_volume_magic[4] = {'S', 'D', 'S', 'N'};
+const std::uint32_t noise_volume_version = 1;
+
+//--------------------------------------------------------------
+inline size_t get_noise_slice_bytes(size_t grid_size, size_t tile_size)
+{
+    const size_t tiles_per_side = get_tiles_per_side(grid_size, tile_size);
+    return tiles_per_side * tiles_per_side * get_tile_bytes(tile_size);
+}
+
+//--------------------------------------------------------------
+// Thresholds one iteration of the noise into a packed slice.
+inline void pack_noise_slice(std::vector<unsigned char>& slice,
+                             const noise_volume_header& header,
+                             unsigned long long iteration)
+{
+    const size_t grid_size = header.grid_size;
+    const size_t tile_size = header.tile_size;
+    slice.assign(get_noise_slice_bytes(grid_size, tile_size), 0);
+    const packed_world_view layout(slice.data(), grid_size, tile_size);
+    for (float x = 0; x < float(grid_size); ++x)
+    {
+        for (float y = 0; y < float(grid_size); ++y)
+        {
+            if (ofNoise(x * header.scale, y * header.scale, float(iteration) * header.speed) > header.threshold)
+            {
+                const size_t bit = get_bit_in_tile(x, y, tile_size);
+                slice[layout.get_byte_offset(x, y)] |= (unsigned char)(1u << (bit % 8));
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------
+inline bool bake_noise_volume(const std::string& path, const noise_volume_header& header)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    std::vector<char> padding(header.data_offset, 0);
+    std::memcpy(padding.data(), &header, sizeof(header));
+    file.write(padding.data(), padding.size());
+
+    std::vector<unsigned char> slice;
+    for (unsigned long long iteration = 0; iteration < header.iterations; ++iteration)
+    {
+        pack_noise_slice(slice, header, iteration);
+        file.write(reinterpret_cast<const char*>(slice.data()), slice.size());
+    }
+    return bool(file);
+}
+
+//--------------------------------------------------------------
+class noise_volume
+{
+private:
+    mapped_file file;
+    noise_volume_header header;
+    size_t slice_bytes;
+    std::vector<unsigned char> live_slice;
+
+    bool matches(const noise_volume_header& wanted) const
+    {
+        if (file.size() < sizeof(noise_volume_header))
+            return false;
+
+        noise_volume_header found;
+        std::memcpy(&found, file.data(), sizeof(found));
+        return std::memcmp(found.magic, noise_volume_magic, sizeof(noise_volume_magic)) == 0 &&
+               found.version == wanted.version &&
+               found.grid_size == wanted.grid_size &&
+               found.tile_size == wanted.tile_size &&
+               found.iterations == wanted.iterations &&
+               found.scale == wanted.scale &&
+               found.speed == wanted.speed &&
+               found.threshold == wanted.threshold &&
+               found.data_offset == wanted.data_offset &&
+               found.data_offset + found.iterations * slice_bytes <= file.size();
+    }
+
+public:
+    noise_volume() :
+        file{},
+        header{},
+        slice_bytes{0},
+        live_slice{}
+    {}
+
+    // Maps the cached volume at path, baking it first if it is missing or was
+    // built with other parameters.
+    bool open(const std::string& path,
+              size_t grid_size,
+              unsigned long long iterations,
+              float scale,
+              float speed,
+              float threshold)
+    {
+        header = noise_volume_header{};
+        std::memcpy(header.magic, noise_volume_magic, sizeof(noise_volume_magic));
+        header.version = noise_volume_version;
+        header.grid_size = grid_size;
+        header.tile_size = default_world_tile_size;
+        header.iterations = std::max<unsigned long long>(iterations, 1);
+        header.scale = scale;
+        header.speed = speed;
+        header.threshold = threshold;
+        header.data_offset = world_file_data_offset;
+        slice_bytes = get_noise_slice_bytes(grid_size, header.tile_size);
+
+        if (file.open(path) && matches(header))
+            return true;
+
+        file.close();
+        if (!bake_noise_volume(path, header))
+            return false;
+        return file.open(path) && matches(header);
+    }
+
+    void close()
+    {
+        file.close();
+    }
+
+    unsigned long long iterations() const
+    {
+        return header.iterations;
+    }
+
+    // Past the end of the baked volume the noise is computed live, exactly as
+    // it would have been baked, so long runs see the same world either way.
+    // That slice stays valid until the next call.
+    packed_world_view slice(unsigned long long iteration)
+    {
+        if (iteration >= header.iterations)
+        {
+            pack_noise_slice(live_slice, header, iteration);
+            return packed_world_view(live_slice.data(), header.grid_size, header.tile_size);
+        }
+        const size_t offset = header.data_offset + iteration * slice_bytes;
+        return packed_world_view(file.data() + offset, header.grid_size, header.tile_size);
+    }
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------------------
+// NUMA placement without libnuma: the node layout comes from sysfs, and pages
+// are placed and queried with the mbind and move_pages system calls. Off
+// Linux, or on a single node machine, everything reports one node and the
+// placement calls do nothing.
+struct numa_locality
+{
+    size_t local = 0;
+    size_t remote = 0;
+
+    double local_ratio() const
+    {
+        const size_t total = local + remote;
+        return total > 0 ? double(local) / double(total) : 1.0;
+    }
+
+    numa_locality& operator+=(const numa_locality& other)
+    {
+        local += other.local;
+        remote += other.remote;
+        return *this;
+    }
+};
+
+//--------------------------------------------------------------
+// Parses sysfs cpu and node lists such as "0-3,8,10-11".
+inline std::vector<int> parse_numa_list(const std::string& list)
+{
+    std::vector<int> values;
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ','))
+    {
+        if (range.empty() || range == "\n")
+            continue;
+        const size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int value = first; value <= last; ++value)
+            values.push_back(value);
+    }
+    return values;
+}
+
+//--------------------------------------------------------------
+inline std::vector<int> read_numa_list(const std::string& path)
+{
+    std::ifstream file(path);
+    std::string list;
+    if (!file || !std::getline(file, list))
+        return {};
+    return parse_numa_list(list);
+}
+
+//--------------------------------------------------------------
+inline int get_numa_node_count()
+{
+#if defined(__linux__)
+    const std::vector<int> nodes = read_numa_list("/sys/devices/system/node/online");
+    return nodes.empty() ? 1 : nodes.back() + 1;
+#else
+    return 1;
+#endif
+}
+
+//--------------------------------------------------------------
+inline size_t get_page_size()
+{
+#if defined(__linux__)
+    return size_t(sysconf(_SC_PAGESIZE));
+#else
+    return 4096;
+#endif
+}
+
+//--------------------------------------------------------------
+// Restricts the calling thread to the cpus of one node. Memory the thread
+// touches first then comes from that node.
+inline bool pin_thread_to_numa_node(int node)
+{
+#if defined(__linux__)
+    const std::vector<int> cpus = read_numa_list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    if (cpus.empty())
+        return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus)
+        CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)node;
+    return false;
+#endif
+}
+
+//--------------------------------------------------------------
+// Spreads the pages of a buffer round robin over every node, moving pages
+// that already exist. Used for data every thread reads, such as the world.
+inline bool interleave_across_numa_nodes(const void* data, size_t bytes)
+{
+#if defined(__linux__)
+    const int nodes = get_numa_node_count();
+    if (nodes < 2 || bytes == 0)
+        return false;
+
+    const std::uintptr_t page_size = get_page_size();
+    const std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(data) & ~(page_size - 1);
+    const std::uintptr_t end = reinterpret_cast<std::uintptr_t>(data) + bytes;
+    std::vector<unsigned long> mask((size_t(nodes) + 63) / 64, 0);
+    for (int node = 0; node < nodes; ++node)
+        mask[size_t(node) / 64] |= 1ul << (node % 64);
+    return syscall(SYS_mbind, begin, end - begin, MPOL_INTERLEAVE, mask.data(), (unsigned long)(nodes) + 1, MPOL_MF_MOVE) == 0;
+#else
+    (void)data;
+    (void)bytes;
+    return false;
+#endif
+}
+
+//--------------------------------------------------------------
+// The node each given address currently lives on, or -1 for pages that are
+// not resident.
+inline std::vector<int> get_numa_nodes(const std::vector<const void*>& addresses)
+{
+    std::vector<int> nodes(addresses.size(), 0);
+#if defined(__linux__)
+    if (addresses.empty() || get_numa_node_count() < 2)
+        return nodes;
+
+    const std::uintptr_t page_size = get_page_size();
+    std::vector<void*> pages(addresses.size());
+    for (size_t i = 0; i < addresses.size(); ++i)
+        pages[i] = reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(addresses[i]) & ~(page_size - 1));
+    if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, nodes.data(), 0) != 0)
+        nodes.assign(addresses.size(), -1);
+#endif
+    return nodes;
+}
+
+//--------------------------------------------------------------
+// How many of the given addresses live on the expected node.
+inline numa_locality get_numa_locality(const std::vector<const void*>& addresses, int node)
+{
+    numa_locality report;
+    for (const int page_node : get_numa_nodes(addresses))
+    {
+        if (page_node == node)
+            ++report.local;
+        else if (page_node >= 0)
+            ++report.remote;
+    }
+    return report;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "huge_page_allocator.h"
+
+#include <vector>
+#include <unordered_set>
+#include <cstddef>
+#include <algorithm>
+
+//--------------------------------------------------------------
+// Which cells are currently being mined. Each cell stores the generation it
+// was last marked in, so clearing the whole grid is a single increment and
+// per-iteration upkeep only touches the cells agents occupy. Worlds too big
+// to hold a stamp per cell fall back to a set of the occupied cells.
+class occupancy_grid
+{
+private:
+    static const size_t max_dense_size = 16384;
+
+    std::vector<unsigned int, huge_page_allocator<unsigned int>> stamps;
+    std::unordered_set<size_t> occupied;
+    unsigned int generation;
+    size_t grid_size;
+    bool sparse;
+
+public:
+    occupancy_grid() :
+        stamps{},
+        occupied{},
+        generation{1},
+        grid_size{0},
+        sparse{false}
+    {}
+
+    void resize(size_t size)
+    {
+        grid_size = size;
+        sparse = size > max_dense_size;
+        stamps.assign(sparse ? 0 : size * size, 0);
+        occupied.clear();
+        generation = 1;
+    }
+
+    void clear()
+    {
+        if (sparse)
+        {
+            occupied.clear();
+        }
+        else if (++generation == 0)
+        {
+            // Wrapped around, old stamps could alias the new generation.
+            std::fill(stamps.begin(), stamps.end(), 0);
+            generation = 1;
+        }
+    }
+
+    void set(size_t x, size_t y)
+    {
+        if (sparse)
+            occupied.insert(x * grid_size + y);
+        else
+            stamps[x * grid_size + y] = generation;
+    }
+
+    void unset(size_t x, size_t y)
+    {
+        if (sparse)
+            occupied.erase(x * grid_size + y);
+        else
+            stamps[x * grid_size + y] = 0;
+    }
+
+    bool is_set(size_t x, size_t y) const
+    {
+        if (sparse)
+            return occupied.count(x * grid_size + y) > 0;
+        return stamps[x * grid_size + y] == generation;
+    }
+
+    const unsigned int* get_stamp_data() const
+    {
+        return stamps.data();
+    }
+
+    size_t get_stamp_bytes() const
+    {
+        return stamps.size() * sizeof(unsigned int);
+    }
+};
@@ -8,7 +8,7 @@ std::array<size_t, 2> get_hill_position(size_t index,
                                         size_t grid_size,
                                         float draw_scalar)
 {
-    const auto step = grid_size / quad_size;
+    const auto step = (grid_size + quad_size - 1) / quad_size;
     const size_t remainder = index % step;
     const size_t x = remainder * draw_scalar * quad_size;
     const size_t y = (float(index - remainder) / step) * draw_scalar * quad_size;
@@ -16,60 +16,31 @@ std::array<size_t, 2> get_hill_position(size_t index,
 }
 
 //--------------------------------------------------------------
-size_t get_hill_index(agent& agent,
-                      size_t quad_size,
-                      size_t grid_size)
-{
-    const size_t quadrant_start_x = (agent.x - (agent.x % quad_size)) / quad_size;
-    const size_t quadrant_start_y = (agent.y - (agent.y % quad_size)) / quad_size;
-    return quadrant_start_x + quadrant_start_y * grid_size / quad_size;
-}
-
-//--------------------------------------------------------------
-void grid_world_middle_bias(std::vector<std::vector<std::pair<int, bool>>>& world,
+void grid_world_middle_bias(grid_world& world,
                             random_uniform& uniform_random)
 {
-    for (size_t x = 0; x < world.size(); ++x)
+    const float centre_x = float(world.size()) / 2.0f;
+    const float centre_y = float(world.size()) / 2.0f;
+    world.for_each_cell([&](size_t x, size_t y, unsigned char& cell)
     {
-        for (size_t y = 0; y < world[x].size(); ++y)
-        {
-            const float centre_x = float(world.size()) / 2.0f;
-            const float centre_y = float(world.size()) / 2.0f;
-            const size_t prob_x = abs(centre_x - x);
-            const size_t prob_y = abs(centre_y - y);
-            const size_t prob = size_t(float(prob_x + prob_y) / 3.0f);
-            world[x][y].first = uniform_random.get_next(prob * prob + 1) == 1;
-            world[x][y].second = false;
-        }
-    }
+        const size_t prob_x = abs(centre_x - x);
+        const size_t prob_y = abs(centre_y - y);
+        const size_t prob = size_t(float(prob_x + prob_y) / 3.0f);
+        cell = uniform_random.get_next(prob * prob + 1) == 1;
+    });
 }
 
 //--------------------------------------------------------------
-void grid_world_moving_noise(std::vector<std::vector<std::pair<int, bool>>>& world,
-                             unsigned long long iteration)
+void grid_world_moving_noise(grid_world& world,
+                             unsigned long long iteration,
+                             float scale,
+                             float speed,
+                             float threshold)
 {
-    const float scale = 0.01f;
-    const float speed = 0.005f;
-    for (float x = 0; x < float(world.size()); ++x)
+    world.for_each_cell([&](size_t x, size_t y, unsigned char& cell)
     {
-        for (float y = 0; y < float(world.size()); ++y)
-        {
-            world[x][y].first = ofNoise(x * scale, y * scale, float(iteration) * speed) > 0.9;
-            world[x][y].second = false;
-        }
-    }
-}
-
-//--------------------------------------------------------------
-void clear_grid_world(std::vector<std::vector<std::pair<int, bool>>>& world,
-                      std::vector<std::shared_ptr<agent>>& agents)
-{
-    for (size_t x = 0; x < world.size(); ++x)
-        for (size_t y = 0; y < world.size(); ++y)
-            world[x][y].second = false;
-    
-    for (auto& agent : agents)
-        world[agent->x][agent->y].second = true;
+        cell = ofNoise(float(x) * scale, float(y) * scale, float(iteration) * speed) > threshold;
+    });
 }
 
 //--------------------------------------------------------------
@@ -83,36 +54,44 @@ bool agent_is_in_same_position(std::shared_ptr<agent>& prospective_agent,
 }
 
 //--------------------------------------------------------------
-void set_agent_randomly_in_same_quadrant(const std::shared_ptr<agent>& happy,
-                                         std::shared_ptr<agent>& unhappy,
-                                         std::vector<std::shared_ptr<agent>>& agents,
-                                         std::vector<std::vector<std::pair<int, bool>>>& world,
-                                         size_t quad_size,
-                                         std::size_t grid_size,
-                                         random_uniform& uniform_random)
+void test_agents_by_tile(std::vector<std::shared_ptr<agent>>& agents,
+                         std::vector<std::shared_ptr<agent>>& batch,
+                         tiled_world& world)
 {
-    const size_t quadrant_start_x = happy->x - (happy->x % quad_size);
-    const size_t quadrant_start_y = happy->y - (happy->y % quad_size);
-    const size_t random_x = uniform_random.get_next(quad_size);
-    const size_t random_y = uniform_random.get_next(quad_size);
-    const size_t x = std::min(random_x + quadrant_start_x, grid_size - 1);
-    const size_t y = std::min(random_y + quadrant_start_y, grid_size - 1);
-    const bool already_being_mined = world[x][y].second;
+    batch.clear();
+    for (auto& agent : agents)
+        if (agent->moved)
+            batch.push_back(agent);
     
-    world[unhappy->x][unhappy->y].second = false;
-    if (already_being_mined)
+    // Testing tile by tile means each tile is fetched at most once per pass.
+    std::sort(batch.begin(), batch.end(), [&world](const std::shared_ptr<agent>& lhs,
+                                                   const std::shared_ptr<agent>& rhs)
     {
-        unhappy->x = uniform_random.get_next(grid_size - 1);
-        unhappy->y = uniform_random.get_next(grid_size - 1);
-    }
-    else
+        return world.get_tile(lhs->x, lhs->y) < world.get_tile(rhs->x, rhs->y);
+    });
+    
+    for (auto& agent : batch)
     {
-        unhappy->x = x;
-        unhappy->y = y;
+        agent->set_happy(world);
+        agent->moved = false;
     }
-    world[unhappy->x][unhappy->y].second = true;
 }
 
+//--------------------------------------------------------------
+void prefetch_agent_tiles(std::vector<std::shared_ptr<agent>>& agents,
+                          std::vector<size_t>& tiles,
+                          tiled_world& world)
+{
+    tiles.clear();
+    for (auto& agent : agents)
+        if (agent->moved)
+            tiles.push_back(world.get_tile(agent->x, agent->y));
+    
+    std::sort(tiles.begin(), tiles.end());
+    tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+    for (const size_t tile : tiles)
+        world.prefetch(tile);
+}
 
 //--------------------------------------------------------------
 void ofApp::setup()
@@ -123,41 +102,140 @@ void ofApp::setup()
     run = false;
     noise = false;
     moving = false;
+    noise_scale = 0.01f;
+    noise_speed = 0.005f;
+    noise_threshold = 0.9f;
     iteration = 0;
     grid_size = 200;
     partial_size = 20;
     
-    // We need complete hills
-    assert(grid_size % partial_size == 0);
+    // Worlds can also come from a world file (press 'w' to write one). Mapped
+    // worlds are shared read-only through the page cache, worlds bigger than
+    // memory are streamed from disk a tile at a time. Video worlds play one
+    // thresholded frame per iteration. Baked noise serves the moving noise
+    // world from a cache file rather than evaluating the noise every time,
+    // for the first max_iteration iterations and live after that.
+    source = world_source::generated;
+    world_path = "world.sdsw";
+    video_path = "noise_3d.mov";
+    tile_cache_size = 4096;
+    video_partial_grid.close();
+    if (source == world_source::mapped)
+    {
+        if (mapped_partial_grid.open(ofToDataPath(world_path)))
+        {
+            world_view = mapped_partial_grid.view();
+            grid_size = mapped_partial_grid.grid_size();
+            partial_size = mapped_partial_grid.partial_size();
+        }
+        else
+        {
+            ofLogError("ofApp") << "Could not map " << world_path << ", generating a world instead";
+            source = world_source::generated;
+        }
+    }
+    else if (source == world_source::video)
+    {
+        if (video_partial_grid.open(ofToDataPath(video_path), grid_size, 8, 230))
+        {
+            video_partial_grid.next_frame(world_view, true);
+        }
+        else
+        {
+            ofLogError("ofApp") << "Could not load " << video_path << ", generating a world instead";
+            source = world_source::generated;
+        }
+    }
+    else if (source == world_source::baked_noise)
+    {
+        if (baked_noise_grid.open(ofToDataPath("noise_volume.sdsn"),
+                                  grid_size,
+                                  max_iteration + 1,
+                                  noise_scale,
+                                  noise_speed,
+                                  noise_threshold))
+        {
+            world_view = baked_noise_grid.slice(iteration);
+        }
+        else
+        {
+            ofLogError("ofApp") << "Could not bake the noise volume, generating a world instead";
+            source = world_source::generated;
+        }
+    }
+    else if (source == world_source::out_of_core)
+    {
+        if (out_of_core_world.open(ofToDataPath(world_path), tile_cache_size))
+        {
+            grid_size = out_of_core_world.grid_size();
+            partial_size = out_of_core_world.partial_size();
+        }
+        else
+        {
+            ofLogError("ofApp") << "Could not open " << world_path << ", generating a world instead";
+            source = world_source::generated;
+        }
+    }
+    
+    geometry = hill_geometry(grid_size, partial_size);
+    phases = get_sds_phases(grid_size, partial_size);
     
     partial_grid.clear();
-    partial_grid.resize(grid_size);
-    for (auto& col : partial_grid)
-        col.resize(grid_size, std::make_pair(0, false));
+    if (source == world_source::generated)
+        partial_grid.resize(grid_size, partial_size);
     
     agent_size = 100;
+    agent_sort_interval = 8;
+    
+    // Agents poll anyone unless a lattice topology is chosen. Sorting would
+    // move agents between lattice positions, so lattices are left unsorted.
+    topology = communication_topology::full;
+    population.lattice.topology = topology;
+    if (topology != communication_topology::full)
+        agent_sort_interval = 0;
+    
+    reset_population(population, agent_size, grid_size);
+    
+    // Hills are counted exactly; top_k keeps only the heaviest 64 hills, so
+    // memory stays fixed however many hills the world has.
+    population.hill_indices.reset(hill_counting::exact, 64);
+    top_hill_count = 10;
+    top_hills.clear();
     
-    agents.clear();
-    agents.reserve(agent_size);
-    for (size_t i = 0; i < agent_size; ++i)
+    // A non-zero stride scores overlapping hill sized windows that start every
+    // window_stride cells, instead of the fixed hills.
+    window_stride = 0;
+    windows = hill_windows();
+    if (window_stride > 0)
+        windows.reset(grid_size, partial_size, window_stride);
+    
+    // With more than one island, independent populations of agent_size agents
+    // search on their own threads, trading happy agents every few iterations.
+    island_count = 1;
+    island_iterations = 10;
+    if (island_count > 1 && source != world_source::out_of_core)
+        islands.reset(island_count, agent_size, grid_size, island_iterations, 0.1f);
+    else
+        islands.clear();
+    
+    if (source == world_source::out_of_core)
+        prefetch_agent_tiles(population.agents, prefetch_tiles, out_of_core_world);
+    else if (source == world_source::generated)
     {
-        auto a = std::make_shared<agent>();
-        a->x = uniform_random.get_next(grid_size - 1);
-        a->y = uniform_random.get_next(grid_size - 1);
-        a->happy = false;
-        partial_grid[a->x][a->y].second = true;
-        agents.push_back(a);
+        if (noise)
+            grid_world_moving_noise(partial_grid, iteration, noise_scale, noise_speed, noise_threshold);
+        else
+            grid_world_middle_bias(partial_grid, population.uniform_random);
     }
     
-    happy_agents.clear();
-    happy_agents.reserve(agents.size());
-    unhappy_agents.clear();
-    unhappy_agents.reserve(agents.size());
+    // Every island reads the whole world, so spread it over the NUMA nodes.
+    if (islands.size() > 0 && source == world_source::generated)
+        interleave_across_numa_nodes(partial_grid.get_data(), partial_grid.get_byte_count());
     
-    if (noise)
-        grid_world_moving_noise(partial_grid, iteration);
-    else
-        grid_world_middle_bias(partial_grid, uniform_random);
+    if (source == world_source::generated)
+        ofLogNotice("ofApp") << describe_huge_pages("world", partial_grid.get_data(), partial_grid.get_byte_count());
+    ofLogNotice("ofApp") << describe_huge_pages("occupancy", population.occupancy.get_stamp_data(), population.occupancy.get_stamp_bytes());
+    ofLogNotice("ofApp") << describe_huge_pages("agents", population.agent_storage->data(), agent_size * sizeof(agent));
     
     draw_scalar = float(ofGetWidth()) / float(grid_size);
     
@@ -180,66 +258,78 @@ void ofApp::update()
     }
     else if (run)
     {
-        if (noise && moving)
-            grid_world_moving_noise(partial_grid, iteration);
-        else
-            clear_grid_world(partial_grid, agents);
+        // In a static world an agent that has not moved would read the same
+        // cell again, so only re-test agents that moved during diffusion.
+        bool world_changed = false;
+        if (source == world_source::video)
+        {
+            world_changed = video_partial_grid.next_frame(world_view);
+        }
+        else if (source == world_source::baked_noise)
+        {
+            world_view = baked_noise_grid.slice(iteration);
+            world_changed = true;
+        }
+        else if (noise && moving && source == world_source::generated)
+        {
+            grid_world_moving_noise(partial_grid, iteration, noise_scale, noise_speed, noise_threshold);
+            world_changed = true;
+        }
         
-        happy_agents.clear();
-        unhappy_agents.clear();
+        if (islands.size() > 0)
+        {
+            const size_t best_index = (source == world_source::generated)
+                ? islands.run(partial_grid, world_changed, island_iterations, phases, geometry)
+                : islands.run(world_view, world_changed, island_iterations, phases, geometry);
+            best_hill_coordinates = get_hill_position(best_index, partial_size, grid_size, draw_scalar);
+            ofSetWindowTitle(save_name + std::string(": ") + std::to_string(iteration) +
+                             std::string(", migrations ") + std::to_string(islands.get_migrations()) +
+                             std::string(", numa local ") + ofToString(islands.get_numa_report().local_ratio() * 100.0, 1) + "%");
+            return;
+        }
         
-        size_t max_indices = 0;
-        size_t best_index = 0;
-        most_frequent_hill_indices.clear();
-        for (auto& agent : agents)
+        begin_iteration(population);
+        if (agent_sort_interval > 0 && iteration % agent_sort_interval == 0)
         {
-            if (agent->set_happy(partial_grid))
-            {
-                happy_agents.push_back(agent);
-                const size_t hill_index = get_hill_index((*agent), partial_size, grid_size);
-                
-                if (++most_frequent_hill_indices[hill_index] > max_indices)
+            if (source == world_source::generated)
+                sort_agents_spatially(population.agents, sorted_agents, sort_scratch, [this](const agent& a)
                 {
-                    max_indices = most_frequent_hill_indices[hill_index];
-                    best_index = hill_index;
-                }
-            }
+                    return std::uint64_t(partial_grid.get_offset(a.x, a.y));
+                });
             else
-                unhappy_agents.push_back(agent);
+                sort_agents_spatially(population.agents, sorted_agents, sort_scratch, [](const agent& a)
+                {
+                    return get_morton_code(a.x, a.y);
+                });
         }
         
-        best_hill_coordinates = get_hill_position(best_index, partial_size, grid_size, draw_scalar);
+        if (source == world_source::out_of_core)
+            test_agents_by_tile(population.agents, tile_batch, out_of_core_world);
+        else if (source == world_source::generated)
+            test_population(population, partial_grid, world_changed);
+        else
+            test_population(population, world_view, world_changed);
         
-        for (auto& agent : unhappy_agents)
+        if (!windows.empty())
+            windows.update(population.agents);
+        
+        const size_t best_index = finish_iteration(population, phases, geometry);
+        best_hill_coordinates = get_hill_position(best_index, partial_size, grid_size, draw_scalar);
+        top_hills = population.hill_indices.get_top(top_hill_count);
+        if (!windows.empty())
         {
-            if (happy_agents.size() > 0)
-            {
-                size_t random_index = uniform_random.get_next(agent_size - 1);
-                if (agents[random_index]->happy)
-                {
-                    set_agent_randomly_in_same_quadrant(agents[random_index],
-                                                        agent,
-                                                        agents,
-                                                        partial_grid,
-                                                        partial_size,
-                                                        grid_size,
-                                                        uniform_random);
-                }
-                else
-                {
-                    agent->x = uniform_random.get_next(grid_size - 1);
-                    agent->y = uniform_random.get_next(grid_size - 1);
-                    
-                }
-            }
-            else
-            {
-                agent->x = uniform_random.get_next(grid_size - 1);
-                agent->y = uniform_random.get_next(grid_size - 1);
-            }
+            const hill_windows::window best = windows.get_best_window();
+            best_hill_coordinates = {size_t(best.x * draw_scalar), size_t(best.y * draw_scalar)};
         }
         
-        ofSetWindowTitle(save_name + std::string(": ") + std::to_string(iteration));
+        std::string title = save_name + std::string(": ") + std::to_string(iteration);
+        if (source == world_source::out_of_core)
+        {
+            // Agents are heading to their new positions, start reading those tiles now.
+            prefetch_agent_tiles(population.agents, prefetch_tiles, out_of_core_world);
+            title += std::string(", ") + out_of_core_world.get_stats().to_string();
+        }
+        ofSetWindowTitle(title);
     }
     else
     {
@@ -250,12 +340,13 @@ void ofApp::update()
 //--------------------------------------------------------------
 void ofApp::draw()
 {
-    // Gold or not gold?
-    for (size_t x = 0; x < grid_size; ++x)
+    // Gold or not gold? Out of core worlds are too big to draw.
+    for (size_t x = 0; x < grid_size && source != world_source::out_of_core; ++x)
     {
         for (size_t y = 0; y < grid_size; ++y)
         {
-            const ofColor c = (partial_grid[x][y].first == 0) ? ofColor::black : ofColor::gold;
+            const bool gold = (source == world_source::generated) ? partial_grid.is_gold(x, y) : world_view.is_gold(x, y);
+            const ofColor c = gold ? ofColor::gold : ofColor::black;
             ofSetColor(c);
             ofDrawRectangle(x * draw_scalar, y * draw_scalar, draw_scalar, draw_scalar);
         }
@@ -263,14 +354,24 @@ void ofApp::draw()
     
     // Grid lines
     ofSetColor(255, 125);
-    for (size_t i = 1; i < grid_size / partial_size; ++i)
+    for (size_t i = 1; i * partial_size < grid_size; ++i)
     {
         const float pos = i * partial_size * draw_scalar;
-        const float max = grid_size / partial_size * partial_size * draw_scalar;
+        const float max = grid_size * draw_scalar;
         ofDrawLine(pos, 0, pos, max);
         ofDrawLine(0, pos, max, pos);
     }
     
+    // Runners up
+    ofNoFill();
+    ofSetColor(ofColor::red, 127);
+    for (size_t i = 1; i < top_hills.size(); ++i)
+    {
+        const auto position = get_hill_position(top_hills[i].index, partial_size, grid_size, draw_scalar);
+        ofDrawRectangle(position[0], position[1], partial_size * draw_scalar, partial_size * draw_scalar);
+    }
+    ofFill();
+    
     // Best partial
     ofSetColor(255, 127);
     ofDrawRectangle(best_hill_coordinates[0], best_hill_coordinates[1], partial_size * draw_scalar, partial_size * draw_scalar);
@@ -283,10 +384,16 @@ void ofApp::draw()
     // Agents
     const float increment = float(partial_size) / 2.0;
     const float inc = draw_scalar / 2.0;
-    for (auto& agent : agents)
+    for (size_t i = 0; i < population.agents.size() && islands.size() == 0; ++i)
     {
+        const auto& agent = population.agents[i];
         ofDrawCircle(agent->x * draw_scalar + inc, agent->y * draw_scalar + inc, draw_scalar / 3.0);
     }
+    for (size_t i = 0; i < islands.size(); ++i)
+    {
+        for (auto& agent : islands.get_population(i).agents)
+            ofDrawCircle(agent->x * draw_scalar + inc, agent->y * draw_scalar + inc, draw_scalar / 3.0);
+    }
     
     if (run)
     {
@@ -302,5 +409,16 @@ void ofApp::draw()
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key)
 {
-    run = !run;
+    if (key == 'w' && source == world_source::generated)
+    {
+        const bool written = write_world_file(ofToDataPath(world_path),
+                                              grid_size,
+                                              default_world_tile_size,
+                                              partial_size,
+                                              [this](size_t x, size_t y) { return partial_grid.is_gold(x, y); });
+        if (!written)
+            ofLogError("ofApp") << "Could not write " << world_path;
+    }
+    else
+        run = !run;
 }
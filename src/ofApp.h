@@ -2,41 +2,20 @@
 
 #include "ofMain.h"
 #include <random>
+#include "sds_engine.h"
+#include "island_search.h"
+#include "hill_windows.h"
+#include "video_world.h"
+#include "noise_volume.h"
 
 //--------------------------------------------------------------
-class agent
+enum class world_source
 {
-public:
-    size_t x, y;
-    bool happy;
-   
-    bool set_happy(const std::vector<std::vector<std::pair<int, bool>>>& world)
-    {
-        happy = world[x][y].first == 1;
-        return happy;
-    }
-};
-
-//--------------------------------------------------------------
-class random_uniform
-{
-private:
-    std::random_device random_device;
-    std::mt19937 random_number_generator;
-    std::uniform_real_distribution<double> uniform_distribution;
-    
-public:
-    random_uniform() :
-        random_device{},
-        random_number_generator{random_device()},
-        uniform_distribution{0.0, 1.0}
-    {}
-    
-    size_t get_next(size_t max)
-    {
-        const double result = uniform_distribution(random_number_generator);
-        return size_t(std::round(result * max));
-    }
+    generated,
+    mapped,
+    video,
+    baked_noise,
+    out_of_core
 };
 
 //--------------------------------------------------------------
@@ -49,24 +28,47 @@ public:
 	void keyPressed(int key);
     
 private:
-    random_uniform uniform_random;
-    
     size_t grid_size;
     size_t partial_size;
-    std::vector<std::vector<std::pair<int, bool>>> partial_grid;
-    std::map<size_t, size_t> most_frequent_hill_indices;
+    hill_geometry geometry;
+    sds_phases phases;
+    grid_world partial_grid;
+    
+    world_source source;
+    std::string world_path;
+    std::string video_path;
+    mapped_world mapped_partial_grid;
+    video_world video_partial_grid;
+    noise_volume baked_noise_grid;
+    packed_world_view world_view;
+    size_t tile_cache_size;
+    tiled_world out_of_core_world;
+    std::vector<std::shared_ptr<agent>> tile_batch;
+    std::vector<size_t> prefetch_tiles;
     std::array<size_t, 2> best_hill_coordinates;
+    size_t top_hill_count;
+    std::vector<hill_count> top_hills;
+    size_t window_stride;
+    hill_windows windows;
     
     float draw_scalar;
     
     size_t agent_size;
-    std::vector<std::shared_ptr<agent>> happy_agents;
-    std::vector<std::shared_ptr<agent>> unhappy_agents;
-    std::vector<std::shared_ptr<agent>> agents;
+    communication_topology topology;
+    sds_population population;
+    size_t island_count;
+    size_t island_iterations;
+    island_search islands;
+    size_t agent_sort_interval;
+    std::vector<std::pair<std::uint64_t, agent>> sorted_agents;
+    std::vector<std::pair<std::uint64_t, agent>> sort_scratch;
     
     bool run;
     bool noise;
     bool moving;
+    float noise_scale;
+    float noise_speed;
+    float noise_threshold;
     bool save_output;
     unsigned long long iteration;
     unsigned long long max_iteration;
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "sds_engine.h"
+
+#include <algorithm>
+#include <vector>
+
+//--------------------------------------------------------------
+// A square window onto a world, in window coordinates. Cells past the edge
+// of the world are never gold, so a window cut short by the edge still has
+// its full size and every hill inside it stays aligned with the world's.
+template <typename world_type>
+struct world_region
+{
+    const world_type& world;
+    size_t origin_x;
+    size_t origin_y;
+    size_t world_size;
+
+    bool is_gold(size_t x, size_t y) const
+    {
+        return origin_x + x < world_size && origin_y + y < world_size && world.is_gold(origin_x + x, origin_y + y);
+    }
+
+    // Only used to prefetch, so clamping to the world is good enough.
+    const unsigned char* get_cell_address(size_t x, size_t y) const
+    {
+        return world.get_cell_address(std::min(origin_x + x, world_size - 1), std::min(origin_y + y, world_size - 1));
+    }
+};
+
+//--------------------------------------------------------------
+struct pyramid_result
+{
+    size_t x = 0;
+    size_t y = 0;
+    size_t hill_index = 0;
+    size_t levels = 0;
+    size_t iterations = 0;
+    size_t tests = 0;
+};
+
+//--------------------------------------------------------------
+// Coarse to fine search. The first level runs on super-hills of
+// partial_size * branching^k cells; once its best super-hill has held for
+// stable_iterations iterations, the next level searches only inside it with
+// hills branching times smaller, down to partial_size. The same population is
+// carried from level to level: agents already inside the winning region keep
+// their place and the rest are scattered over it.
+class pyramid_search
+{
+private:
+    sds_population population;
+    std::vector<size_t> level_sizes;
+    size_t grid_size;
+    size_t partial_size;
+
+    // Re-seats every agent in the next region, in that region's coordinates.
+    void narrow(size_t hill_x, size_t hill_y, size_t region_size)
+    {
+        for (auto& a : population.agents)
+        {
+            const bool inside = a->x >= hill_x && a->x < hill_x + region_size &&
+                                a->y >= hill_y && a->y < hill_y + region_size;
+            a->x = inside ? a->x - hill_x : population.uniform_random.get_next(region_size - 1);
+            a->y = inside ? a->y - hill_y : population.uniform_random.get_next(region_size - 1);
+            a->moved = true;
+        }
+        population.occupancy.resize(region_size);
+    }
+
+public:
+    pyramid_search() :
+        population{},
+        level_sizes{},
+        grid_size{0},
+        partial_size{1}
+    {}
+
+    void reset(size_t grid, size_t partial, size_t branching, size_t agent_count)
+    {
+        grid_size = grid;
+        partial_size = partial;
+        level_sizes.assign(1, partial);
+        while (branching > 1 && level_sizes.back() * branching < grid)
+            level_sizes.push_back(level_sizes.back() * branching);
+        std::reverse(level_sizes.begin(), level_sizes.end());
+        reset_population(population, agent_count, grid);
+    }
+
+    sds_population& get_population()
+    {
+        return population;
+    }
+
+    const std::vector<size_t>& get_level_sizes() const
+    {
+        return level_sizes;
+    }
+
+    template <typename world_type>
+    pyramid_result run(const world_type& world,
+                       size_t max_iterations_per_level,
+                       size_t stable_iterations)
+    {
+        pyramid_result result;
+        for (auto& a : population.agents)
+        {
+            a->x = population.uniform_random.get_next(grid_size - 1);
+            a->y = population.uniform_random.get_next(grid_size - 1);
+            a->moved = true;
+        }
+        population.occupancy.resize(grid_size);
+        
+        size_t origin_x = 0;
+        size_t origin_y = 0;
+        size_t region_size = grid_size;
+        for (const size_t level_size : level_sizes)
+        {
+            const hill_geometry geometry(region_size, level_size);
+            const sds_phases phases = get_sds_phases(geometry.grid_size, geometry.quad_size);
+            const world_region<world_type> region{world, origin_x, origin_y, grid_size};
+            size_t best_index = 0;
+            size_t streak = 0;
+            for (size_t i = 0; i < max_iterations_per_level && streak < stable_iterations; ++i)
+            {
+                begin_iteration(population);
+                result.tests += test_agents_prefetched(population.agents, region, i == 0);
+                const size_t index = finish_iteration(population, phases, geometry);
+                streak = (index == best_index && population.hill_indices.get_count(index) > 0) ? streak + 1 : 0;
+                best_index = index;
+                ++result.iterations;
+            }
+            ++result.levels;
+
+            const size_t hill_x = (best_index % geometry.hills_per_side) * level_size;
+            const size_t hill_y = (best_index / geometry.hills_per_side) * level_size;
+            origin_x += hill_x;
+            origin_y += hill_y;
+            if (level_size != partial_size)
+                narrow(hill_x, hill_y, level_size);
+            region_size = level_size;
+        }
+
+        result.x = origin_x;
+        result.y = origin_y;
+        result.hill_index = hill_geometry(grid_size, partial_size).get_hill_index(origin_x, origin_y);
+        return result;
+    }
+};
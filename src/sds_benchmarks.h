@@ -0,0 +1,157 @@
+#pragma once
+
+#include "sds_engine.h"
+#include "sds_core.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+//--------------------------------------------------------------
+struct convergence_result
+{
+    bool converged = false;
+    size_t iterations = 0;
+    double seconds = 0.0;
+    size_t best_hill = 0;
+    size_t best_count = 0;
+};
+
+//--------------------------------------------------------------
+inline const char* get_topology_name(communication_topology topology)
+{
+    switch (topology)
+    {
+        case communication_topology::ring: return "ring";
+        case communication_topology::torus: return "torus";
+        case communication_topology::small_world: return "small world";
+        default: return "full";
+    }
+}
+
+//--------------------------------------------------------------
+// Iterates a population over a static world until the best hill holds at
+// least the given fraction of the agents, or max_iterations runs out.
+template <typename world_type>
+convergence_result run_until_converged(sds_population& population,
+                                       const world_type& world,
+                                       const sds_phases& phases,
+                                       const hill_geometry& geometry,
+                                       size_t max_iterations,
+                                       float fraction)
+{
+    convergence_result result;
+    const size_t target = size_t(std::ceil(float(population.agents.size()) * fraction));
+    const auto start = std::chrono::steady_clock::now();
+    while (result.iterations < max_iterations && !result.converged)
+    {
+        begin_iteration(population);
+        test_population(population, world, result.iterations == 0);
+        result.best_hill = finish_iteration(population, phases, geometry);
+        result.best_count = population.hill_indices.get_count(result.best_hill);
+        result.converged = result.best_count >= target;
+        ++result.iterations;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+//--------------------------------------------------------------
+struct accuracy_result
+{
+    bool correct = false;
+    size_t iterations = 0;
+    // Cells actually tested up to that iteration.
+    size_t tests = 0;
+    double seconds = 0.0;
+};
+
+//--------------------------------------------------------------
+// Iterates until the best hill has been one of the truly best hills for
+// stable_iterations iterations in a row, so a lucky guess does not count.
+// Reports the iterations, tests and time to the start of that run.
+// iterate(i, tests) runs iteration i, adds the cells it tested to tests and
+// returns its best hill; has_happy(hill) says whether any agent is happy
+// there, as an iteration without happy agents has no real best hill.
+template <typename iteration, typename happy_check>
+accuracy_result run_iterations_until_correct(iteration iterate,
+                                             happy_check has_happy,
+                                             const std::vector<std::uint32_t>& hill_counts,
+                                             size_t max_iterations,
+                                             size_t stable_iterations)
+{
+    const std::uint32_t best_count = *std::max_element(hill_counts.begin(), hill_counts.end());
+    accuracy_result result;
+    size_t streak = 0;
+    size_t tests = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < max_iterations; ++i)
+    {
+        const size_t best_hill = iterate(i, tests);
+        
+        const bool correct = has_happy(best_hill) && hill_counts[best_hill] == best_count;
+        if (correct && streak++ == 0)
+        {
+            result.iterations = i + 1;
+            result.tests = tests;
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        else if (!correct)
+            streak = 0;
+        
+        if (streak >= stable_iterations)
+        {
+            result.correct = true;
+            return result;
+        }
+    }
+    result.iterations = max_iterations;
+    result.tests = tests;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+//--------------------------------------------------------------
+template <typename world_type>
+accuracy_result run_until_correct(sds_population& population,
+                                  const world_type& world,
+                                  const sds_phases& phases,
+                                  const hill_geometry& geometry,
+                                  const std::vector<std::uint32_t>& hill_counts,
+                                  size_t max_iterations,
+                                  size_t stable_iterations)
+{
+    return run_iterations_until_correct([&](size_t i, size_t& tests)
+    {
+        begin_iteration(population);
+        tests += test_population(population, world, i == 0);
+        return finish_iteration(population, phases, geometry);
+    },
+    [&](size_t best_hill)
+    {
+        return population.hill_indices.get_count(best_hill) > 0;
+    },
+    hill_counts, max_iterations, stable_iterations);
+}
+
+//--------------------------------------------------------------
+// As above, for a search built on sds_core whose clusters are hills. The core
+// tests every agent every iteration.
+template <typename hypothesis_type, typename test_policy, typename recruitment_policy>
+accuracy_result run_until_correct(sds_core<hypothesis_type, test_policy, recruitment_policy>& search,
+                                  const std::vector<std::uint32_t>& hill_counts,
+                                  size_t max_iterations,
+                                  size_t stable_iterations)
+{
+    return run_iterations_until_correct([&](size_t, size_t& tests)
+    {
+        tests += search.size();
+        return search.iterate();
+    },
+    [&](size_t)
+    {
+        return search.get_happy_count() > 0;
+    },
+    hill_counts, max_iterations, stable_iterations);
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include "sds_engine.h"
+
+#include <vector>
+
+//--------------------------------------------------------------
+// The SDS loop with the search domain left open. A search is described by
+// three types, all resolved at compile time so the inner loops inline the
+// domain's code instead of calling through pointers:
+//
+// hypothesis_type, any copyable value, is what an agent believes.
+//
+// test_policy runs one microfeature test:
+//     bool test(const hypothesis_type& hypothesis, random_uniform& uniform_random);
+//
+// recruitment_policy decides where agents go:
+//     hypothesis_type get_random(random_uniform& uniform_random);
+//     void begin_diffusion(const std::vector<hypothesis_type>& hypotheses);
+//     void diffuse(hypothesis_type& unhappy, const hypothesis_type& polled, bool recruited, random_uniform& uniform_random);
+//     size_t get_cluster(const hypothesis_type& hypothesis) const;
+// diffuse() is called for every unhappy agent with a randomly polled agent;
+// recruited is whether the polled agent is happy. get_cluster() groups
+// hypotheses, e.g. by hill, so the core can report the strongest cluster.
+template <typename hypothesis_type, typename test_policy, typename recruitment_policy>
+class sds_core
+{
+private:
+    test_policy tester;
+    recruitment_policy recruiter;
+    random_uniform uniform_random;
+    std::vector<hypothesis_type> hypotheses;
+    std::vector<unsigned char> happy;
+    std::vector<size_t> polled;
+    hill_counter clusters;
+    size_t happy_count;
+
+public:
+    sds_core() :
+        tester{},
+        recruiter{},
+        uniform_random{},
+        hypotheses{},
+        happy{},
+        polled{},
+        clusters{},
+        happy_count{0}
+    {
+        clusters.reset(hill_counting::exact, 0);
+    }
+
+    test_policy& get_test()
+    {
+        return tester;
+    }
+
+    recruitment_policy& get_recruitment()
+    {
+        return recruiter;
+    }
+
+    random_uniform& get_random()
+    {
+        return uniform_random;
+    }
+
+    hill_counter& get_clusters()
+    {
+        return clusters;
+    }
+
+    // Set up the policies first, since the agents start at random hypotheses
+    // drawn from the recruitment policy.
+    void reset(size_t agent_count)
+    {
+        hypotheses.clear();
+        hypotheses.reserve(agent_count);
+        for (size_t i = 0; i < agent_count; ++i)
+            hypotheses.push_back(recruiter.get_random(uniform_random));
+        happy.assign(agent_count, 0);
+        happy_count = 0;
+        clusters.clear();
+    }
+
+    size_t size() const
+    {
+        return hypotheses.size();
+    }
+
+    size_t get_happy_count() const
+    {
+        return happy_count;
+    }
+
+    const std::vector<hypothesis_type>& get_hypotheses() const
+    {
+        return hypotheses;
+    }
+
+    bool is_happy(size_t index) const
+    {
+        return happy[index];
+    }
+
+    // Tests every agent, counts the happy ones by cluster and diffuses the
+    // rest, returning the cluster with the most happy agents.
+    size_t iterate()
+    {
+        const size_t agent_count = hypotheses.size();
+        if (agent_count == 0)
+            return 0;
+
+        clusters.clear();
+        happy_count = 0;
+        size_t best_cluster = 0;
+        size_t best_count = 0;
+        for (size_t i = 0; i < agent_count; ++i)
+        {
+            happy[i] = tester.test(hypotheses[i], uniform_random);
+            if (!happy[i])
+                continue;
+            ++happy_count;
+            const size_t cluster = recruiter.get_cluster(hypotheses[i]);
+            const size_t count = clusters.add(cluster);
+            if (count > best_count)
+            {
+                best_count = count;
+                best_cluster = cluster;
+            }
+        }
+
+        // Polls are drawn before anyone moves, so every agent sees the
+        // hypotheses as they were tested.
+        uniform_random.fill_next(polled, agent_count, agent_count - 1);
+        recruiter.begin_diffusion(hypotheses);
+        for (size_t i = 0; i < agent_count; ++i)
+        {
+            if (happy[i])
+                continue;
+            const hypothesis_type polled_hypothesis = hypotheses[polled[i]];
+            recruiter.diffuse(hypotheses[i], polled_hypothesis, happy_count > 0 && happy[polled[i]], uniform_random);
+        }
+        return best_cluster;
+    }
+};
+
+//--------------------------------------------------------------
+// The gold grid search expressed through sds_core: a hypothesis is a cell,
+// the test is whether it holds gold, and recruits move to a free cell in
+// the hill of the agent that recruited them.
+struct grid_hypothesis
+{
+    size_t x;
+    size_t y;
+};
+
+//--------------------------------------------------------------
+template <typename world_type>
+class gold_cell_test
+{
+private:
+    const world_type* world;
+
+public:
+    gold_cell_test() :
+        world{nullptr}
+    {}
+
+    void reset(const world_type& searched)
+    {
+        world = &searched;
+    }
+
+    bool test(const grid_hypothesis& hypothesis, random_uniform&) const
+    {
+        return world->is_gold(hypothesis.x, hypothesis.y);
+    }
+};
+
+//--------------------------------------------------------------
+// The engine's diffusion an agent at a time, through the same
+// move_unhappy_agent(): a recruit lands in the polled agent's hill unless
+// that cell is already being mined, in which case, as when not recruited,
+// it moves anywhere.
+template <typename geometry>
+class same_hill_recruitment
+{
+private:
+    geometry hills;
+    occupancy_grid occupancy;
+
+public:
+    same_hill_recruitment() :
+        hills{hill_geometry(1, 1)},
+        occupancy{}
+    {}
+
+    void reset(const hill_geometry& runtime_geometry)
+    {
+        hills = geometry(runtime_geometry);
+        occupancy.resize(hills.get_grid_size());
+    }
+
+    grid_hypothesis get_random(random_uniform& uniform_random)
+    {
+        const size_t last = hills.get_grid_size() - 1;
+        grid_hypothesis hypothesis;
+        hypothesis.x = uniform_random.get_next(last);
+        hypothesis.y = uniform_random.get_next(last);
+        return hypothesis;
+    }
+
+    void begin_diffusion(const std::vector<grid_hypothesis>& hypotheses)
+    {
+        occupancy.clear();
+        for (const auto& hypothesis : hypotheses)
+            occupancy.set(hypothesis.x, hypothesis.y);
+    }
+
+    void diffuse(grid_hypothesis& unhappy, const grid_hypothesis& polled, bool recruited, random_uniform& uniform_random)
+    {
+        const size_t quad_size = hills.get_quad_size();
+        const size_t offset_x = uniform_random.get_next(quad_size);
+        const size_t offset_y = uniform_random.get_next(quad_size);
+        const grid_hypothesis random = get_random(uniform_random);
+        move_unhappy_agent(unhappy.x, unhappy.y, polled.x, polled.y, recruited,
+                           offset_x, offset_y, random.x, random.y, hills, occupancy);
+    }
+
+    size_t get_cluster(const grid_hypothesis& hypothesis) const
+    {
+        return hills.get_hill_index(hypothesis.x, hypothesis.y);
+    }
+};
+
+//--------------------------------------------------------------
+template <typename world_type, typename geometry = hill_geometry>
+using gold_grid_sds = sds_core<grid_hypothesis, gold_cell_test<world_type>, same_hill_recruitment<geometry>>;
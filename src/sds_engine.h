@@ -0,0 +1,636 @@
+#pragma once
+
+#include "occupancy_grid.h"
+#include "hill_geometry.h"
+#include "grid_world.h"
+#include "test_kernels.h"
+#include "tiled_world.h"
+#include "mapped_world.h"
+#include "huge_page_allocator.h"
+#include "hill_counter.h"
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+//--------------------------------------------------------------
+class agent
+{
+public:
+    size_t x, y;
+    bool happy;
+    bool moved;
+   
+    // world_type is deduced const for read-only worlds; tiled_world pages
+    // tiles in as it reads, so it is tested through a non-const reference.
+    template <typename world_type>
+    bool set_happy(world_type& world)
+    {
+        happy = world.is_gold(x, y);
+        return happy;
+    }
+};
+
+//--------------------------------------------------------------
+class random_uniform
+{
+private:
+    std::random_device random_device;
+    std::mt19937 random_number_generator;
+    std::uniform_real_distribution<double> uniform_distribution;
+    
+public:
+    random_uniform() :
+        random_device{},
+        random_number_generator{random_device()},
+        uniform_distribution{0.0, 1.0}
+    {}
+    
+    // Restarts from a fixed seed, so runs can be repeated.
+    void seed(unsigned int value)
+    {
+        random_number_generator.seed(value);
+        uniform_distribution.reset();
+    }
+    
+    size_t get_next(size_t max)
+    {
+        const double result = uniform_distribution(random_number_generator);
+        return size_t(std::round(result * max));
+    }
+    
+    void fill_next(std::vector<size_t>& values, size_t count, size_t max)
+    {
+        values.resize(count);
+        for (auto& value : values)
+            value = get_next(max);
+    }
+};
+
+//--------------------------------------------------------------
+// Random numbers drawn in bulk for one iteration of diffusion.
+struct diffusion_batch
+{
+    std::vector<size_t> polled;
+    std::vector<size_t> offset_x;
+    std::vector<size_t> offset_y;
+    std::vector<size_t> random_x;
+    std::vector<size_t> random_y;
+};
+
+//--------------------------------------------------------------
+// Which agents an unhappy agent may poll. Fully connected polls anyone; the
+// others only poll neighbours on a fixed lattice over agent indices, so the
+// polled agent sits close by in memory.
+enum class communication_topology
+{
+    full,
+    ring,
+    torus,
+    small_world
+};
+
+//--------------------------------------------------------------
+struct communication_lattice
+{
+    communication_topology topology = communication_topology::full;
+    size_t size = 0;
+    size_t width = 0;
+    size_t height = 0;
+    std::vector<size_t> shortcuts;
+    
+    size_t get_degree() const
+    {
+        switch (topology)
+        {
+            case communication_topology::ring: return 2;
+            case communication_topology::torus: return 4;
+            case communication_topology::small_world: return 5;
+            default: return size;
+        }
+    }
+    
+    // The choice'th of the nearest agents on a ring, alternating sides and
+    // working outwards: choices 0 and 1 are one step away, 2 and 3 two.
+    size_t get_ring_neighbour(size_t index, size_t choice) const
+    {
+        const size_t step = (choice / 2 + 1) % size;
+        return (choice % 2 == 0) ? (index + step) % size : (index + size - step) % size;
+    }
+    
+    // The choice'th neighbour of an agent, choice < get_degree().
+    size_t get_neighbour(size_t index, size_t choice) const
+    {
+        switch (topology)
+        {
+            case communication_topology::ring:
+                return get_ring_neighbour(index, choice);
+            case communication_topology::torus:
+            {
+                // Fewer than three columns would make the left and right
+                // neighbours the same agent, or the agent itself.
+                if (width < 3)
+                    return get_ring_neighbour(index, choice);
+                const size_t x = index % width;
+                const size_t y = index / width;
+                switch (choice)
+                {
+                    case 0: return y * width + (x + 1) % width;
+                    case 1: return y * width + (x + width - 1) % width;
+                    case 2: return ((y + 1) % height) * width + x;
+                    default: return ((y + height - 1) % height) * width + x;
+                }
+            }
+            case communication_topology::small_world:
+            {
+                // The two nearest on each side of a ring, plus one long link.
+                if (choice == 4)
+                    return shortcuts[index];
+                return get_ring_neighbour(index, choice);
+            }
+            default:
+                return choice;
+        }
+    }
+};
+
+//--------------------------------------------------------------
+// The torus is as square as the agent count allows. Counts with no factor
+// of at least 3 up to their square root, primes among them, leave fewer
+// than three columns, and get_neighbour() then treats the torus as a ring
+// of the four nearest agents. Small-world shortcuts are drawn once and kept,
+// and never link an agent to itself.
+inline void reset_lattice(communication_lattice& lattice,
+                          communication_topology topology,
+                          size_t agent_count,
+                          random_uniform& uniform_random)
+{
+    lattice.topology = topology;
+    lattice.size = agent_count;
+    lattice.width = 1;
+    for (size_t width = 1; width * width <= agent_count; ++width)
+        if (agent_count % width == 0)
+            lattice.width = width;
+    lattice.height = agent_count / std::max<size_t>(lattice.width, 1);
+    
+    lattice.shortcuts.clear();
+    if (topology == communication_topology::small_world && agent_count > 1)
+    {
+        // Drawn from the other agent_count - 1 agents, skipping over self.
+        uniform_random.fill_next(lattice.shortcuts, agent_count, agent_count - 2);
+        for (size_t i = 0; i < agent_count; ++i)
+            lattice.shortcuts[i] += lattice.shortcuts[i] >= i;
+    }
+    else if (topology == communication_topology::small_world)
+        lattice.shortcuts.assign(agent_count, 0);
+}
+
+//--------------------------------------------------------------
+// The per-agent phases of an iteration, instantiated for a particular hill
+// geometry. See get_sds_phases().
+struct sds_phases
+{
+    size_t (*count_happy_agents)(std::vector<std::shared_ptr<agent>>& agents,
+                                 std::vector<std::shared_ptr<agent>>& happy_agents,
+                                 std::vector<std::shared_ptr<agent>>& unhappy_agents,
+                                 hill_counter& hill_indices,
+                                 const hill_geometry& geometry);
+    
+    void (*diffuse_unhappy_agents)(std::vector<std::shared_ptr<agent>>& agents,
+                                   std::vector<std::shared_ptr<agent>>& unhappy_agents,
+                                   bool any_happy,
+                                   occupancy_grid& occupancy,
+                                   random_uniform& uniform_random,
+                                   diffusion_batch& batch,
+                                   const hill_geometry& geometry);
+    
+    void (*diffuse_on_lattice)(std::vector<std::shared_ptr<agent>>& agents,
+                               const communication_lattice& lattice,
+                               bool any_happy,
+                               occupancy_grid& occupancy,
+                               random_uniform& uniform_random,
+                               diffusion_batch& batch,
+                               const hill_geometry& geometry);
+};
+
+//--------------------------------------------------------------
+inline void clear_occupancy(occupancy_grid& occupancy,
+                     std::vector<std::shared_ptr<agent>>& agents)
+{
+    occupancy.clear();
+    
+    for (auto& agent : agents)
+        occupancy.set(agent->x, agent->y);
+}
+
+//--------------------------------------------------------------
+// Moves one unhappy agent, at (x, y), given the random numbers drawn for it.
+// A recruited agent goes to the offset cell in the polled agent's hill,
+// unless that cell is already being mined; otherwise it goes to the random
+// cell. The outcome is picked with selects rather than branches.
+template <typename geometry>
+void move_unhappy_agent(size_t& x,
+                        size_t& y,
+                        size_t polled_x,
+                        size_t polled_y,
+                        bool recruited,
+                        size_t offset_x,
+                        size_t offset_y,
+                        size_t random_x,
+                        size_t random_y,
+                        const geometry& hills,
+                        occupancy_grid& occupancy)
+{
+    const size_t grid_size = hills.get_grid_size();
+    const size_t hill_x = std::min(hills.get_quadrant_start(polled_x) + offset_x, grid_size - 1);
+    const size_t hill_y = std::min(hills.get_quadrant_start(polled_y) + offset_y, grid_size - 1);
+    recruited = recruited & !occupancy.is_set(hill_x, hill_y);
+    
+    occupancy.unset(x, y);
+    x = recruited ? hill_x : random_x;
+    y = recruited ? hill_y : random_y;
+    occupancy.set(x, y);
+}
+
+//--------------------------------------------------------------
+template <typename geometry>
+size_t count_happy_agents(std::vector<std::shared_ptr<agent>>& agents,
+                          std::vector<std::shared_ptr<agent>>& happy_agents,
+                          std::vector<std::shared_ptr<agent>>& unhappy_agents,
+                          hill_counter& hill_indices,
+                          const hill_geometry& runtime_geometry)
+{
+    const geometry hills(runtime_geometry);
+    size_t max_indices = 0;
+    size_t best_index = 0;
+    for (auto& agent : agents)
+    {
+        if (agent->happy)
+        {
+            happy_agents.push_back(agent);
+            const size_t hill_index = hills.get_hill_index(agent->x, agent->y);
+            
+            const size_t count = hill_indices.add(hill_index);
+            if (count > max_indices)
+            {
+                max_indices = count;
+                best_index = hill_index;
+            }
+        }
+        else
+            unhappy_agents.push_back(agent);
+    }
+    return best_index;
+}
+
+//--------------------------------------------------------------
+// Every unhappy agent polls a random agent. If that agent is happy, the
+// unhappy one moves to a random free cell in the same quadrant; otherwise,
+// or if the cell is already being mined, it moves anywhere at random. All
+// the random numbers for the iteration are drawn up front.
+template <typename geometry>
+void diffuse_unhappy_agents(std::vector<std::shared_ptr<agent>>& agents,
+                            std::vector<std::shared_ptr<agent>>& unhappy_agents,
+                            bool any_happy,
+                            occupancy_grid& occupancy,
+                            random_uniform& uniform_random,
+                            diffusion_batch& batch,
+                            const hill_geometry& runtime_geometry)
+{
+    const geometry hills(runtime_geometry);
+    const size_t grid_size = hills.get_grid_size();
+    const size_t quad_size = hills.get_quad_size();
+    const size_t count = unhappy_agents.size();
+    
+    uniform_random.fill_next(batch.polled, count, agents.size() - 1);
+    uniform_random.fill_next(batch.offset_x, count, quad_size);
+    uniform_random.fill_next(batch.offset_y, count, quad_size);
+    uniform_random.fill_next(batch.random_x, count, grid_size - 1);
+    uniform_random.fill_next(batch.random_y, count, grid_size - 1);
+    
+    for (size_t i = 0; i < count; ++i)
+    {
+        agent& unhappy = *unhappy_agents[i];
+        const agent& polled = *agents[batch.polled[i]];
+        move_unhappy_agent(unhappy.x, unhappy.y, polled.x, polled.y, any_happy & polled.happy,
+                           batch.offset_x[i], batch.offset_y[i], batch.random_x[i], batch.random_y[i],
+                           hills, occupancy);
+        unhappy.moved = true;
+    }
+}
+
+//--------------------------------------------------------------
+// As diffuse_unhappy_agents(), but each unhappy agent polls one of its
+// lattice neighbours instead of any agent at all.
+template <typename geometry>
+void diffuse_agents_on_lattice(std::vector<std::shared_ptr<agent>>& agents,
+                               const communication_lattice& lattice,
+                               bool any_happy,
+                               occupancy_grid& occupancy,
+                               random_uniform& uniform_random,
+                               diffusion_batch& batch,
+                               const hill_geometry& runtime_geometry)
+{
+    const geometry hills(runtime_geometry);
+    const size_t grid_size = hills.get_grid_size();
+    const size_t quad_size = hills.get_quad_size();
+    
+    size_t count = 0;
+    for (const auto& agent : agents)
+        count += !agent->happy;
+    
+    uniform_random.fill_next(batch.polled, count, lattice.get_degree() - 1);
+    uniform_random.fill_next(batch.offset_x, count, quad_size);
+    uniform_random.fill_next(batch.offset_y, count, quad_size);
+    uniform_random.fill_next(batch.random_x, count, grid_size - 1);
+    uniform_random.fill_next(batch.random_y, count, grid_size - 1);
+    
+    size_t j = 0;
+    for (size_t i = 0; i < agents.size(); ++i)
+    {
+        agent& unhappy = *agents[i];
+        if (unhappy.happy)
+            continue;
+        const agent& polled = *agents[lattice.get_neighbour(i, batch.polled[j])];
+        move_unhappy_agent(unhappy.x, unhappy.y, polled.x, polled.y, any_happy & polled.happy,
+                           batch.offset_x[j], batch.offset_y[j], batch.random_x[j], batch.random_y[j],
+                           hills, occupancy);
+        unhappy.moved = true;
+        ++j;
+    }
+}
+
+//--------------------------------------------------------------
+// Agents are interchangeable, so rather than reordering the pointers we sort
+// the agents' state and write it back in pointer order. Walking agents in
+// order then walks both the agents and the world in memory order.
+template <typename spatial_key>
+void sort_agents_spatially(std::vector<std::shared_ptr<agent>>& agents,
+                           std::vector<std::pair<std::uint64_t, agent>>& keyed,
+                           std::vector<std::pair<std::uint64_t, agent>>& scratch,
+                           spatial_key get_key)
+{
+    keyed.clear();
+    std::uint64_t max_key = 0;
+    for (auto& agent : agents)
+    {
+        keyed.emplace_back(get_key(*agent), *agent);
+        max_key = std::max(max_key, keyed.back().first);
+    }
+    
+    // Least significant byte first, stopping once the remaining bytes are zero.
+    scratch.resize(keyed.size());
+    for (unsigned int shift = 0; shift < 64 && (max_key >> shift) != 0; shift += 8)
+    {
+        std::array<size_t, 257> counts{};
+        for (const auto& entry : keyed)
+            ++counts[((entry.first >> shift) & 0xff) + 1];
+        for (size_t i = 1; i < counts.size(); ++i)
+            counts[i] += counts[i - 1];
+        for (const auto& entry : keyed)
+            scratch[counts[(entry.first >> shift) & 0xff]++] = entry;
+        keyed.swap(scratch);
+    }
+    
+    for (size_t i = 0; i < agents.size(); ++i)
+        *agents[i] = keyed[i].second;
+}
+
+//--------------------------------------------------------------
+template <typename geometry>
+sds_phases make_sds_phases()
+{
+    return { &count_happy_agents<geometry>,
+             &diffuse_unhappy_agents<geometry>,
+             &diffuse_agents_on_lattice<geometry> };
+}
+
+//--------------------------------------------------------------
+// Geometries we run often get their own instantiation with the sizes baked
+// in. Anything else falls back to shifts for powers of two, or plain division.
+inline sds_phases get_sds_phases(size_t grid_size, size_t quad_size)
+{
+    struct specialisation
+    {
+        size_t grid_size;
+        size_t quad_size;
+        sds_phases phases;
+    };
+    
+    static const specialisation specialisations[] = {
+        {200, 20, make_sds_phases<fixed_hill_geometry<200, 20>>()},
+        {1000, 50, make_sds_phases<fixed_hill_geometry<1000, 50>>()},
+        {10000, 100, make_sds_phases<fixed_hill_geometry<10000, 100>>()},
+        {256, 16, make_sds_phases<fixed_hill_geometry<256, 16>>()},
+        {512, 32, make_sds_phases<fixed_hill_geometry<512, 32>>()},
+        {1024, 32, make_sds_phases<fixed_hill_geometry<1024, 32>>()},
+        {1024, 64, make_sds_phases<fixed_hill_geometry<1024, 64>>()},
+        {4096, 64, make_sds_phases<fixed_hill_geometry<4096, 64>>()},
+        {8192, 128, make_sds_phases<fixed_hill_geometry<8192, 128>>()},
+    };
+    
+    for (const auto& specialised : specialisations)
+        if (specialised.grid_size == grid_size && specialised.quad_size == quad_size)
+            return specialised.phases;
+    
+    if (is_power_of_two(grid_size) && is_power_of_two(quad_size))
+        return make_sds_phases<power_of_two_hill_geometry>();
+    return make_sds_phases<hill_geometry>();
+}
+
+//--------------------------------------------------------------
+// Tests agents in order while prefetching ahead of the current one: first the
+// agent's own state, then, once that has arrived, the cell it sits on. Each
+// test then finds its cell already in cache instead of stalling on memory.
+// Returns the number of agents tested.
+template <typename world_type>
+size_t test_agents_prefetched(std::vector<std::shared_ptr<agent>>& agents,
+                            const world_type& world,
+                            bool world_changed)
+{
+    const size_t cell_distance = 8;
+    const size_t agent_distance = cell_distance * 2;
+    const size_t count = agents.size();
+    size_t tested = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i + agent_distance < count)
+            __builtin_prefetch(agents[i + agent_distance].get(), 1);
+        
+        if (i + cell_distance < count)
+        {
+            const auto& ahead = agents[i + cell_distance];
+            if (world_changed || ahead->moved)
+                __builtin_prefetch(world.get_cell_address(ahead->x, ahead->y), 0, 1);
+        }
+        
+        auto& agent = agents[i];
+        if (world_changed || agent->moved)
+        {
+            agent->set_happy(world);
+            ++tested;
+        }
+        agent->moved = false;
+    }
+    return tested;
+}
+
+//--------------------------------------------------------------
+// The gather kernels address the world with 32-bit bit addresses.
+template <typename world_type>
+bool fits_test_kernel(const world_type& world)
+{
+    return world.get_bit_count() <= std::uint64_t(std::numeric_limits<std::uint32_t>::max()) + 1;
+}
+
+//--------------------------------------------------------------
+// Collects the cells of the agents that need testing into one flat array of
+// bit addresses and hands them to a vectorised gather kernel. Returns the
+// number of agents tested.
+template <typename world_type>
+size_t test_agents_gathered(std::vector<std::shared_ptr<agent>>& agents,
+                          const world_type& world,
+                          bool world_changed,
+                          test_kernel kernel,
+                          std::vector<std::uint32_t>& addresses,
+                          std::vector<std::uint32_t>& indices,
+                          std::vector<unsigned char>& results)
+{
+    addresses.clear();
+    indices.clear();
+    for (size_t i = 0; i < agents.size(); ++i)
+    {
+        auto& agent = agents[i];
+        if (world_changed || agent->moved)
+        {
+            addresses.push_back(std::uint32_t(world.get_bit_address(agent->x, agent->y)));
+            indices.push_back(std::uint32_t(i));
+        }
+        agent->moved = false;
+    }
+    
+    results.resize(addresses.size());
+    kernel(world.get_data(), addresses.data(), results.data(), addresses.size());
+    for (size_t i = 0; i < indices.size(); ++i)
+        agents[indices[i]]->happy = results[i];
+    return indices.size();
+}
+
+//--------------------------------------------------------------
+// Everything one population of agents needs to run, so several can search
+// the same world side by side.
+struct sds_population
+{
+    random_uniform uniform_random;
+    occupancy_grid occupancy;
+    diffusion_batch diffusion;
+    std::shared_ptr<std::vector<agent, huge_page_allocator<agent>>> agent_storage;
+    std::vector<std::shared_ptr<agent>> agents;
+    std::vector<std::shared_ptr<agent>> happy_agents;
+    std::vector<std::shared_ptr<agent>> unhappy_agents;
+    hill_counter hill_indices;
+    communication_lattice lattice;
+    test_kernel gather_test;
+    std::vector<std::uint32_t> test_addresses;
+    std::vector<std::uint32_t> test_indices;
+    std::vector<unsigned char> test_results;
+    
+    sds_population() :
+        gather_test{get_test_kernel()}
+    {}
+};
+
+//--------------------------------------------------------------
+inline void reset_population(sds_population& population,
+                             size_t agent_size,
+                             size_t grid_size)
+{
+    population.occupancy.resize(grid_size);
+    
+    // The agents live in one contiguous block; the pointers share ownership
+    // of the whole block rather than owning one agent each.
+    population.agent_storage = std::make_shared<std::vector<agent, huge_page_allocator<agent>>>(agent_size);
+    population.agents.clear();
+    population.agents.reserve(agent_size);
+    for (size_t i = 0; i < agent_size; ++i)
+    {
+        std::shared_ptr<agent> a(population.agent_storage, &(*population.agent_storage)[i]);
+        a->x = population.uniform_random.get_next(grid_size - 1);
+        a->y = population.uniform_random.get_next(grid_size - 1);
+        a->happy = false;
+        a->moved = true;
+        population.occupancy.set(a->x, a->y);
+        population.agents.push_back(a);
+    }
+    
+    reset_lattice(population.lattice, population.lattice.topology, agent_size, population.uniform_random);
+    
+    population.happy_agents.clear();
+    population.happy_agents.reserve(agent_size);
+    population.unhappy_agents.clear();
+    population.unhappy_agents.reserve(agent_size);
+}
+
+//--------------------------------------------------------------
+inline void begin_iteration(sds_population& population)
+{
+    clear_occupancy(population.occupancy, population.agents);
+    population.happy_agents.clear();
+    population.unhappy_agents.clear();
+    population.hill_indices.clear();
+}
+
+//--------------------------------------------------------------
+// Returns the number of agents tested; in a static world only those that
+// moved are.
+template <typename world_type>
+size_t test_population(sds_population& population,
+                       const world_type& world,
+                       bool world_changed)
+{
+    if (fits_test_kernel(world))
+        return test_agents_gathered(population.agents,
+                                    world,
+                                    world_changed,
+                                    population.gather_test,
+                                    population.test_addresses,
+                                    population.test_indices,
+                                    population.test_results);
+    return test_agents_prefetched(population.agents, world, world_changed);
+}
+
+//--------------------------------------------------------------
+// Counts hills and diffuses once every agent's happiness is known, returning
+// the index of the hill with the most happy agents.
+inline size_t finish_iteration(sds_population& population,
+                               const sds_phases& phases,
+                               const hill_geometry& geometry)
+{
+    const size_t best_index = phases.count_happy_agents(population.agents,
+                                                        population.happy_agents,
+                                                        population.unhappy_agents,
+                                                        population.hill_indices,
+                                                        geometry);
+    if (population.lattice.topology == communication_topology::full)
+        phases.diffuse_unhappy_agents(population.agents,
+                                      population.unhappy_agents,
+                                      population.happy_agents.size() > 0,
+                                      population.occupancy,
+                                      population.uniform_random,
+                                      population.diffusion,
+                                      geometry);
+    else
+        phases.diffuse_on_lattice(population.agents,
+                                  population.lattice,
+                                  population.happy_agents.size() > 0,
+                                  population.occupancy,
+                                  population.uniform_random,
+                                  population.diffusion,
+                                  geometry);
+    return best_index;
+}
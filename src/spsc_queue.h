@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+//--------------------------------------------------------------
+// A bounded lock-free queue for exactly one producer thread and one consumer
+// thread. The capacity is rounded up to a power of two.
+template <typename T>
+class spsc_queue
+{
+private:
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+
+public:
+    explicit spsc_queue(size_t capacity = 1024) :
+        slots{},
+        mask{0},
+        head{0},
+        tail{0}
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+
+    // Producer only. Fails rather than blocks when the queue is full.
+    bool try_push(const T& value)
+    {
+        const size_t current_tail = tail.load(std::memory_order_relaxed);
+        if (current_tail - head.load(std::memory_order_acquire) > mask)
+            return false;
+        slots[current_tail & mask] = value;
+        tail.store(current_tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only.
+    bool try_pop(T& value)
+    {
+        const size_t current_head = head.load(std::memory_order_relaxed);
+        if (current_head == tail.load(std::memory_order_acquire))
+            return false;
+        value = slots[current_head & mask];
+        head.store(current_head + 1, std::memory_order_release);
+        return true;
+    }
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+//--------------------------------------------------------------
+// Test kernels read one bit per agent from a world and write whether each
+// agent is happy, returning how many are. Agents are given as bit addresses
+// into the world: byte address * 8 + bit, so byte-per-cell worlds (cells are
+// 0 or 1, so bit 0) and bit packed worlds use the same kernels. Cells are
+// read as the aligned 32-bit word containing them, which never crosses into
+// memory the world does not own.
+typedef size_t (*test_kernel)(const unsigned char* world,
+                              const std::uint32_t* bit_addresses,
+                              unsigned char* happy,
+                              size_t count);
+
+//--------------------------------------------------------------
+inline size_t test_cells_scalar(const unsigned char* world,
+                                const std::uint32_t* bit_addresses,
+                                unsigned char* happy,
+                                size_t count)
+{
+    size_t happy_count = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const std::uint32_t address = bit_addresses[i];
+        happy[i] = (world[address >> 3] >> (address & 7)) & 1;
+        happy_count += happy[i];
+    }
+    return happy_count;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+//--------------------------------------------------------------
+__attribute__((target("avx2")))
+inline size_t test_cells_avx2(const unsigned char* world,
+                              const std::uint32_t* bit_addresses,
+                              unsigned char* happy,
+                              size_t count)
+{
+    const int* words = reinterpret_cast<const int*>(world);
+    const __m256i bit_mask = _mm256_set1_epi32(31);
+    const __m256i one = _mm256_set1_epi32(1);
+    size_t happy_count = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256i addresses = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bit_addresses + i));
+        const __m256i word_indices = _mm256_srli_epi32(addresses, 5);
+        const __m256i gathered = _mm256_i32gather_epi32(words, word_indices, 4);
+        const __m256i bits = _mm256_and_si256(_mm256_srlv_epi32(gathered, _mm256_and_si256(addresses, bit_mask)), one);
+
+        // Narrow the eight 0 or 1 lanes to bytes, four from each 128-bit half.
+        const __m256i words16 = _mm256_packus_epi32(bits, bits);
+        const __m256i bytes = _mm256_packus_epi16(words16, words16);
+        const int low = _mm_cvtsi128_si32(_mm256_castsi256_si128(bytes));
+        const int high = _mm_cvtsi128_si32(_mm256_extracti128_si256(bytes, 1));
+        __builtin_memcpy(happy + i, &low, sizeof(low));
+        __builtin_memcpy(happy + i + 4, &high, sizeof(high));
+        happy_count += size_t(__builtin_popcount(unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_slli_epi32(bits, 31))))));
+    }
+    return happy_count + test_cells_scalar(world, bit_addresses + i, happy + i, count - i);
+}
+
+//--------------------------------------------------------------
+__attribute__((target("avx512f")))
+inline size_t test_cells_avx512(const unsigned char* world,
+                                const std::uint32_t* bit_addresses,
+                                unsigned char* happy,
+                                size_t count)
+{
+    const __m512i bit_mask = _mm512_set1_epi32(31);
+    const __m512i one = _mm512_set1_epi32(1);
+    size_t happy_count = 0;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m512i addresses = _mm512_loadu_si512(bit_addresses + i);
+        const __m512i word_indices = _mm512_srli_epi32(addresses, 5);
+        const __m512i gathered = _mm512_i32gather_epi32(word_indices, world, 4);
+        const __m512i bits = _mm512_and_si512(_mm512_srlv_epi32(gathered, _mm512_and_si512(addresses, bit_mask)), one);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(happy + i), _mm512_cvtepi32_epi8(bits));
+        happy_count += size_t(__builtin_popcount(_mm512_test_epi32_mask(bits, bits)));
+    }
+    return happy_count + test_cells_scalar(world, bit_addresses + i, happy + i, count - i);
+}
+
+#endif
+
+//--------------------------------------------------------------
+// Picks the widest kernel this CPU can run.
+inline test_kernel get_test_kernel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return &test_cells_avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return &test_cells_avx2;
+#endif
+    return &test_cells_scalar;
+}
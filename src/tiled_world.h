@@ -0,0 +1,213 @@
+#pragma once
+
+#include "world_file.h"
+
+#include <list>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+//--------------------------------------------------------------
+struct tile_cache_stats
+{
+    unsigned long long hits = 0;
+    unsigned long long misses = 0;
+    unsigned long long evictions = 0;
+    unsigned long long prefetches = 0;
+    unsigned long long bytes_read = 0;
+
+    double hit_rate() const
+    {
+        const unsigned long long lookups = hits + misses;
+        return lookups > 0 ? double(hits) / double(lookups) : 0.0;
+    }
+
+    std::string to_string() const
+    {
+        std::ostringstream oss;
+        oss << "tile hit rate " << int(hit_rate() * 100.0) << "%"
+            << ", evictions " << evictions
+            << ", prefetches " << prefetches
+            << ", read " << bytes_read / (1024 * 1024) << "MB";
+        return oss.str();
+    }
+};
+
+//--------------------------------------------------------------
+// A world file that is read a tile at a time into a fixed number of cached
+// tiles, so worlds far larger than memory can be searched. The least recently
+// used tile is evicted when a new one is needed.
+class tiled_world
+{
+private:
+    struct cached_tile
+    {
+        std::vector<unsigned char> bits;
+        std::list<size_t>::iterator position;
+    };
+
+    int file;
+    world_file_header header;
+    size_t tiles_per_side;
+    size_t tile_bytes;
+    size_t capacity;
+    std::list<size_t> recently_used;
+    std::unordered_map<size_t, cached_tile> cache;
+    tile_cache_stats stats;
+
+    off_t get_tile_offset(size_t tile) const
+    {
+        return off_t(header.data_offset + tile * tile_bytes);
+    }
+
+    const std::vector<unsigned char>& fetch(size_t tile)
+    {
+        auto found = cache.find(tile);
+        if (found != cache.end())
+        {
+            ++stats.hits;
+            recently_used.splice(recently_used.begin(), recently_used, found->second.position);
+            return found->second.bits;
+        }
+
+        ++stats.misses;
+        std::vector<unsigned char> bits;
+        if (cache.size() >= capacity)
+        {
+            // Reuse the evicted tile's buffer rather than allocating.
+            const size_t evicted = recently_used.back();
+            recently_used.pop_back();
+            auto victim = cache.find(evicted);
+            bits = std::move(victim->second.bits);
+            cache.erase(victim);
+            ++stats.evictions;
+        }
+        bits.resize(tile_bytes);
+
+        size_t done = 0;
+        while (done < tile_bytes)
+        {
+            const ssize_t result = pread(file, bits.data() + done, tile_bytes - done, get_tile_offset(tile) + done);
+            if (result <= 0)
+            {
+                std::fill(bits.begin() + done, bits.end(), 0);
+                break;
+            }
+            done += size_t(result);
+        }
+        stats.bytes_read += done;
+
+        recently_used.push_front(tile);
+        cached_tile& entry = cache[tile];
+        entry.bits = std::move(bits);
+        entry.position = recently_used.begin();
+        return entry.bits;
+    }
+
+public:
+    tiled_world() :
+        file{-1},
+        header{},
+        tiles_per_side{0},
+        tile_bytes{0},
+        capacity{0}
+    {}
+
+    ~tiled_world()
+    {
+        close();
+    }
+
+    tiled_world(const tiled_world&) = delete;
+    tiled_world& operator=(const tiled_world&) = delete;
+
+    bool open(const std::string& path, size_t cache_tiles)
+    {
+        close();
+        file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+
+        if (pread(file, &header, sizeof(header), 0) != ssize_t(sizeof(header)) ||
+            !is_valid_world_header(header))
+        {
+            close();
+            return false;
+        }
+
+        tiles_per_side = get_tiles_per_side(header.grid_size, header.tile_size);
+        tile_bytes = get_tile_bytes(header.tile_size);
+        capacity = std::max<size_t>(cache_tiles, 1);
+        cache.reserve(capacity);
+        return true;
+    }
+
+    void close()
+    {
+        if (file >= 0)
+            ::close(file);
+        file = -1;
+        cache.clear();
+        recently_used.clear();
+        stats = tile_cache_stats{};
+    }
+
+    bool is_open() const
+    {
+        return file >= 0;
+    }
+
+    size_t grid_size() const
+    {
+        return header.grid_size;
+    }
+
+    size_t tile_size() const
+    {
+        return header.tile_size;
+    }
+
+    size_t partial_size() const
+    {
+        return header.partial_size;
+    }
+
+    size_t get_tile(size_t x, size_t y) const
+    {
+        return get_tile_index(x, y, header.tile_size, tiles_per_side);
+    }
+
+    bool is_gold(size_t x, size_t y)
+    {
+        const auto& bits = fetch(get_tile(x, y));
+        const size_t bit = get_bit_in_tile(x, y, header.tile_size);
+        return (bits[bit / 8] >> (bit % 8)) & 1;
+    }
+
+    // Asks the OS to start reading a tile we expect to need soon, so the later
+    // fetch is served from the page cache instead of waiting on the disk.
+    void prefetch(size_t tile)
+    {
+        if (cache.count(tile) > 0)
+            return;
+
+        ++stats.prefetches;
+#if defined(__APPLE__)
+        radvisory advice;
+        advice.ra_offset = get_tile_offset(tile);
+        advice.ra_count = int(tile_bytes);
+        fcntl(file, F_RDADVISE, &advice);
+#else
+        posix_fadvise(file, get_tile_offset(tile), off_t(tile_bytes), POSIX_FADV_WILLNEED);
+#endif
+    }
+
+    const tile_cache_stats& get_stats() const
+    {
+        return stats;
+    }
+};
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "ofMain.h"
+#include "mapped_world.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------
+// Streams a video as a sequence of worlds. A background thread decodes frames
+// ahead of the simulation, thresholds them and packs them into a ring of
+// worlds, so moving on to the next frame is just swapping which slot is read.
+// The player is created, loaded and stepped on that thread alone, so no
+// backend sees it used from two threads.
+class video_world : public ofThread
+{
+private:
+    enum class load_state
+    {
+        loading,
+        loaded,
+        failed
+    };
+
+    std::string path;
+    load_state state;
+    size_t grid_size;
+    unsigned char threshold;
+
+    std::vector<std::vector<unsigned char>> ring;
+    std::mutex ring_mutex;
+    std::condition_variable ring_changed;
+    size_t current;
+    size_t ready;
+
+    void pack_frame(const ofPixels& pixels, std::vector<unsigned char>& bits) const
+    {
+        std::fill(bits.begin(), bits.end(), 0);
+        const size_t width = pixels.getWidth();
+        const size_t height = pixels.getHeight();
+        const size_t channels = pixels.getNumChannels();
+        const unsigned char* data = pixels.getData();
+        if (data == nullptr || width == 0 || height == 0)
+            return;
+
+        const packed_world_view layout(bits.data(), grid_size, default_world_tile_size);
+        for (size_t y = 0; y < grid_size; ++y)
+        {
+            const size_t row = (y * height / grid_size) * width;
+            for (size_t x = 0; x < grid_size; ++x)
+            {
+                const size_t column = x * width / grid_size;
+                if (data[(row + column) * channels] > threshold)
+                {
+                    const size_t bit = get_bit_in_tile(x, y, default_world_tile_size);
+                    bits[layout.get_byte_offset(x, y)] |= (unsigned char)(1u << (bit % 8));
+                }
+            }
+        }
+    }
+
+    void threadedFunction() override
+    {
+        ofVideoPlayer player;
+        player.setUseTexture(false);
+        const bool loaded = player.load(path);
+        if (loaded)
+        {
+            player.setLoopState(OF_LOOP_NONE);
+            player.setPaused(true);
+            player.firstFrame();
+        }
+        {
+            std::lock_guard<std::mutex> lock(ring_mutex);
+            state = loaded ? load_state::loaded : load_state::failed;
+        }
+        ring_changed.notify_all();
+        if (!loaded)
+            return;
+
+        while (isThreadRunning())
+        {
+            size_t slot = 0;
+            {
+                std::unique_lock<std::mutex> lock(ring_mutex);
+                // Keep one slot back for the frame the simulation is reading.
+                ring_changed.wait_for(lock, std::chrono::milliseconds(50), [this]
+                {
+                    return ready + 1 < ring.size() || !isThreadRunning();
+                });
+                if (ready + 1 >= ring.size())
+                    continue;
+                slot = (current + 1 + ready) % ring.size();
+            }
+
+            // Pack the frame the player is on before stepping, so the first
+            // frame is served first.
+            player.update();
+            pack_frame(player.getPixels(), ring[slot]);
+            if (player.getCurrentFrame() + 1 >= player.getTotalNumFrames())
+                player.firstFrame();
+            else
+                player.nextFrame();
+
+            {
+                std::lock_guard<std::mutex> lock(ring_mutex);
+                ++ready;
+            }
+            ring_changed.notify_all();
+        }
+    }
+
+public:
+    video_world() :
+        path{},
+        state{load_state::loading},
+        grid_size{0},
+        threshold{0},
+        current{0},
+        ready{0}
+    {}
+
+    ~video_world()
+    {
+        close();
+    }
+
+    // Blocks until the decoder thread has loaded the video, or failed to.
+    bool open(const std::string& video_path, size_t size, size_t ring_size, unsigned char gold_threshold)
+    {
+        close();
+        path = video_path;
+        state = load_state::loading;
+        grid_size = size;
+        threshold = gold_threshold;
+        const size_t tiles_per_side = get_tiles_per_side(grid_size, default_world_tile_size);
+        ring.assign(std::max<size_t>(ring_size, 2),
+                    std::vector<unsigned char>(tiles_per_side * tiles_per_side * get_tile_bytes(default_world_tile_size), 0));
+        current = ring.size() - 1;
+        ready = 0;
+        startThread();
+
+        bool loaded = false;
+        {
+            std::unique_lock<std::mutex> lock(ring_mutex);
+            ring_changed.wait(lock, [this] { return state != load_state::loading; });
+            loaded = state == load_state::loaded;
+        }
+        if (!loaded)
+            close();
+        return loaded;
+    }
+
+    void close()
+    {
+        // The thread may already have ended after failing to load, and still
+        // needs joining.
+        if (isThreadRunning())
+        {
+            stopThread();
+            ring_changed.notify_all();
+        }
+        waitForThread(false);
+        ring.clear();
+    }
+
+    // Moves on to the next decoded frame. Returns false, leaving the view on
+    // the previous frame, if the decoder has not caught up; with wait set it
+    // blocks until a frame is ready instead.
+    bool next_frame(packed_world_view& view, bool wait = false)
+    {
+        {
+            std::unique_lock<std::mutex> lock(ring_mutex);
+            if (wait)
+                ring_changed.wait(lock, [this] { return ready > 0 || !isThreadRunning(); });
+            if (ready == 0)
+                return false;
+
+            current = (current + 1) % ring.size();
+            --ready;
+        }
+        ring_changed.notify_all();
+        view = packed_world_view(ring[current].data(), grid_size, default_world_tile_size);
+        return true;
+    }
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------
+// On-disk world layout. A fixed header is followed, at data_offset, by the
+// world split into tile_size x tile_size tiles. Tiles are stored in the same
+// order as hill indices (x + y * tiles_per_side) and each tile is its cells
+// packed one bit per cell, row by row, so a whole tile is one contiguous read.
+struct world_file_header
+{
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t grid_size;
+    std::uint64_t tile_size;
+    std::uint64_t partial_size;
+    std::uint64_t data_offset;
+};
+
+const char world_file_magic[4] = {'S', 'D', 'S', 'W'};
+const std::uint32_t world_file_version = 1;
+const std::uint64_t world_file_data_offset = 4096;
+const std::uint64_t default_world_tile_size = 64;
+
+//--------------------------------------------------------------
+inline size_t get_tiles_per_side(size_t grid_size, size_t tile_size)
+{
+    return (grid_size + tile_size - 1) / tile_size;
+}
+
+//--------------------------------------------------------------
+inline size_t get_tile_bytes(size_t tile_size)
+{
+    return (tile_size * tile_size + 7) / 8;
+}
+
+//--------------------------------------------------------------
+inline size_t get_tile_index(size_t x, size_t y, size_t tile_size, size_t tiles_per_side)
+{
+    return x / tile_size + (y / tile_size) * tiles_per_side;
+}
+
+//--------------------------------------------------------------
+inline size_t get_bit_in_tile(size_t x, size_t y, size_t tile_size)
+{
+    return (y % tile_size) * tile_size + x % tile_size;
+}
+
+//--------------------------------------------------------------
+inline bool is_valid_world_header(const world_file_header& header)
+{
+    return std::memcmp(header.magic, world_file_magic, sizeof(world_file_magic)) == 0 &&
+           header.version == world_file_version &&
+           header.grid_size > 0 &&
+           header.tile_size > 0 &&
+           header.partial_size > 0 &&
+           header.data_offset >= sizeof(world_file_header);
+}
+
+//--------------------------------------------------------------
+// Writes any world that can answer is_gold(x, y) in the tiled bit layout.
+template <typename cell_reader>
+bool write_world_file(const std::string& path,
+                      size_t grid_size,
+                      size_t tile_size,
+                      size_t partial_size,
+                      cell_reader is_gold)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    world_file_header header{};
+    std::memcpy(header.magic, world_file_magic, sizeof(world_file_magic));
+    header.version = world_file_version;
+    header.grid_size = grid_size;
+    header.tile_size = tile_size;
+    header.partial_size = partial_size;
+    header.data_offset = world_file_data_offset;
+
+    std::vector<char> padding(world_file_data_offset, 0);
+    std::memcpy(padding.data(), &header, sizeof(header));
+    file.write(padding.data(), padding.size());
+
+    const size_t tiles_per_side = get_tiles_per_side(grid_size, tile_size);
+    std::vector<unsigned char> tile(get_tile_bytes(tile_size));
+    for (size_t tile_y = 0; tile_y < tiles_per_side; ++tile_y)
+    {
+        for (size_t tile_x = 0; tile_x < tiles_per_side; ++tile_x)
+        {
+            std::fill(tile.begin(), tile.end(), 0);
+            const size_t start_x = tile_x * tile_size;
+            const size_t start_y = tile_y * tile_size;
+            const size_t end_x = std::min(start_x + tile_size, grid_size);
+            const size_t end_y = std::min(start_y + tile_size, grid_size);
+            for (size_t y = start_y; y < end_y; ++y)
+            {
+                for (size_t x = start_x; x < end_x; ++x)
+                {
+                    if (is_gold(x, y))
+                    {
+                        const size_t bit = get_bit_in_tile(x, y, tile_size);
+                        tile[bit / 8] |= (unsigned char)(1u << (bit % 8));
+                    }
+                }
+            }
+            file.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+        }
+    }
+    return bool(file);
+}